@@ -0,0 +1,866 @@
+// 分阶段基准：letterbox、归一化写入张量、推理、NMS 后处理、绘制、二值化 / ROI、QImage 转换和视频定位
+// 在多种分辨率的合成帧和录制视频上逐阶段计时，结果以 JSON 输出，便于比较不同构建、发现性能回退
+//
+// 每个阶段同时统计每次迭代的堆分配次数，--check-allocations 时主机侧稳态阶段有分配即返回 3
+//
+//   Detection_bench --video match.mp4 --out bench.json
+//   Detection_bench --model none --sizes 1280x720,1920x1080 --check-allocations
+#include "buffdetector.h"
+#include "keyframeindex.h"
+#include "mediaprocessor.h"
+#include "postprocess.h"
+#include "tileddetector.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 分配计数：替换全局 operator new（数组和 nothrow 版本默认转发到这里），进程内所有线程的分配都计入
+// cv::Mat 的像素缓冲不经过 operator new，由下面包装的默认 Mat 分配器另外计数
+namespace
+{
+std::atomic<size_t> g_allocations{0};
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 2)
+using MatAccessFlag = cv::AccessFlag;
+#else
+using MatAccessFlag = int;
+#endif
+
+class CountingMatAllocator : public cv::MatAllocator
+{
+public:
+    explicit CountingMatAllocator(cv::MatAllocator* base) : base_(base) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           MatAccessFlag flags, cv::UMatUsageFlags usage) const override
+    {
+        // 包装外部数据的 Mat 不申请像素缓冲
+        if (!data) {
+            g_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        return base_->allocate(dims, sizes, type, data, step, flags, usage);
+    }
+
+    bool allocate(cv::UMatData* u, MatAccessFlag flags, cv::UMatUsageFlags usage) const override
+    {
+        return base_->allocate(u, flags, usage);
+    }
+
+    // 缓冲由 base_ 申请，UMatData 记录的也是 base_，实际不会调用到这里
+    void deallocate(cv::UMatData* u) const override
+    {
+        base_->deallocate(u);
+    }
+
+private:
+    cv::MatAllocator* base_;
+};
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace rm_buff
+{
+
+// 检测器和 MediaProcessor 的友元，把内部的各个阶段单独暴露给基准测试
+class StageBench
+{
+public:
+    explicit StageBench(Detector& detector) : detector_(detector) {}
+
+    // 同步槽完整预处理一次，绑定输入视图并确定 letterbox 参数，之后各阶段可单独重复执行
+    void prepare(const cv::Mat& src)
+    {
+        detector_.prepare_inputs(detector_.sync_slot_, &src, 1, false);
+    }
+
+    bool hostPreprocess() const { return !detector_.config_.graph_preprocess; }
+
+    void letterbox(const cv::Mat& src)
+    {
+        auto& slot = detector_.sync_slot_;
+        detector_.letterbox(src, slot.canvas[0], slot.lb[0], slot.canvas_lb[0]);
+    }
+
+    void normalize()
+    {
+        auto& slot = detector_.sync_slot_;
+        slot.canvas[0].convertTo(slot.input[0], CV_32FC3, 1.0 / 255.0);
+    }
+
+    void infer() { detector_.sync_slot_.request.infer(); }
+
+    // 解码 + NMS + 映射回原图，使用最近一次 infer 的输出
+    void postprocess()
+    {
+        auto& slot = detector_.sync_slot_;
+        detector_.non_max_suppression(slot.request.get_output_tensor(0), 1,
+                                      detector_.conf_threshold_, detector_.nms_threshold_,
+                                      slot.lb.data(), slot.scratch, &detector_.blade_array_);
+    }
+
+    static cv::Mat applyBinary(MediaProcessor& processor, const cv::Mat& frame)
+    {
+        return processor.applyBinary(frame);
+    }
+
+    static cv::Mat extractROI(MediaProcessor& processor, const cv::Mat& frame)
+    {
+        return processor.extractROI(frame);
+    }
+
+    static QImage matToQImage(MediaProcessor& processor, const cv::Mat& mat)
+    {
+        return processor.matToQImage(mat);
+    }
+
+    static QImage toDisplayImage(MediaProcessor& processor, const cv::Mat& mat)
+    {
+        return processor.toDisplayImage(mat);
+    }
+
+private:
+    Detector& detector_;
+};
+
+} // namespace rm_buff
+
+using namespace rm_buff;
+
+namespace
+{
+
+struct BenchOptions {
+    QString modelPath = ":/models/buff.xml";    // "none" 时跳过依赖模型的阶段
+    QStringList videos;
+    std::vector<cv::Size> sizes = {{640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+    int videoFrames = 60;           // 每个视频读入的帧数
+    int warmup = 3;
+    int minIterations = 5;
+    int maxIterations = 100000;
+    double minTimeMs = 300.0;       // 每个阶段至少计时的时长
+    int inputSize = 640;
+    bool tryGpu = false;            // 默认只用 CPU，结果不受设备选择影响
+    bool graphPreprocess = false;   // 图内预处理时 letterbox / 归一化合并为 preprocess 阶段
+    QString outputPath;             // 为空时输出到标准输出
+    bool checkAllocations = false;  // 主机侧稳态阶段有堆分配时以 3 退出
+};
+
+// 稳态下不应申请堆内存的主机侧阶段
+// detect 统计的是 Detect() 扣除推理运行库内部分配后的次数，合成帧和录制视频上都要为 0
+const char* const kAllocationFreeStages[] = {
+    "letterbox", "normalize", "postprocess", "detect", "nms_agnostic", "nms_per_class",
+};
+
+// 一组输入（同一分辨率的合成帧或同一个视频的若干帧）
+struct InputSet {
+    std::string name;
+    std::string kind;               // "synthetic" / "video" / "candidates"
+    cv::Size size;
+    std::vector<cv::Mat> frames;
+};
+
+struct StageResult {
+    std::string input;
+    std::string kind;
+    cv::Size size;
+    std::string stage;
+    int iterations = 0;
+    double meanUs = 0.0;
+    double minUs = 0.0;
+    double p50Us = 0.0;
+    double p95Us = 0.0;
+    double p99Us = 0.0;
+    double maxUs = 0.0;
+    double allocsPerIter = -1.0;    // 每次迭代的堆分配次数，-1 为未统计
+};
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    const size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+StageResult summarize(const InputSet& input, const char* stage, std::vector<double>& samples,
+                      size_t allocations = SIZE_MAX)
+{
+    StageResult result;
+    result.input = input.name;
+    result.kind = input.kind;
+    result.size = input.size;
+    result.stage = stage;
+    result.iterations = static_cast<int>(samples.size());
+    if (samples.empty()) {
+        return result;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double us : samples) {
+        sum += us;
+    }
+    result.meanUs = sum / samples.size();
+    result.minUs = samples.front();
+    result.p50Us = percentile(samples, 0.50);
+    result.p95Us = percentile(samples, 0.95);
+    result.p99Us = percentile(samples, 0.99);
+    result.maxUs = samples.back();
+    if (allocations != SIZE_MAX) {
+        result.allocsPerIter = static_cast<double>(allocations) / samples.size();
+    }
+
+    std::fprintf(stderr, "%-24s %-14s %8d it %12.1f us p50 %12.1f us p95",
+                 result.input.c_str(), stage, result.iterations, result.p50Us, result.p95Us);
+    if (result.allocsPerIter >= 0) {
+        std::fprintf(stderr, " %8.2f alloc", result.allocsPerIter);
+    }
+    std::fprintf(stderr, "\n");
+    return result;
+}
+
+// 是否继续计时：至少 minIterations 次，且累计不足 minTimeMs 时继续（不超过 maxIterations）
+bool keep_measuring(const BenchOptions& options, size_t samples, double totalUs)
+{
+    const int n = static_cast<int>(samples);
+    return n < options.minIterations ||
+           (totalUs < options.minTimeMs * 1000.0 && n < options.maxIterations);
+}
+
+// 逐次计时：预热后至少运行 minIterations 次且累计 minTimeMs，fn 的参数为迭代序号
+// 同时统计计时区间内的堆分配次数（预热中的分配不计入）
+template <typename Fn>
+StageResult measure(const BenchOptions& options, const InputSet& input, const char* stage, Fn&& fn)
+{
+    using Clock = std::chrono::steady_clock;
+
+    int iteration = 0;
+    for (int i = 0; i < options.warmup; ++i) {
+        fn(iteration++);
+    }
+
+    std::vector<double> samples;
+    samples.reserve(1024);
+    double totalUs = 0.0;
+    size_t allocations = 0;
+    while (keep_measuring(options, samples.size(), totalUs)) {
+        const size_t before = g_allocations.load(std::memory_order_relaxed);
+        auto start = Clock::now();
+        fn(iteration++);
+        auto end = Clock::now();
+        allocations += g_allocations.load(std::memory_order_relaxed) - before;
+        const double us = std::chrono::duration<double, std::micro>(end - start).count();
+        samples.push_back(us);
+        totalUs += us;
+    }
+
+    return summarize(input, stage, samples, allocations);
+}
+
+// 合成帧：暗色噪声背景上的亮色圆和矩形，二值化和绘制有接近实际的内容
+cv::Mat make_frame(const cv::Size& size, int seed)
+{
+    cv::Mat frame(size, CV_8UC3);
+    cv::RNG rng(static_cast<uint64_t>(seed) * 7919u + size.area());
+    rng.fill(frame, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(64));
+
+    const int scale = std::max(1, std::min(size.width, size.height) / 16);
+    for (int i = 0; i < 12; ++i) {
+        cv::Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        cv::Scalar color(rng.uniform(0, 80), rng.uniform(0, 80), rng.uniform(180, 256));
+        if (i % 2 == 0) {
+            cv::circle(frame, center, rng.uniform(scale / 2, scale * 2), color, cv::FILLED);
+        } else {
+            cv::Size half(rng.uniform(scale / 2, scale * 2), rng.uniform(scale / 4, scale));
+            cv::rectangle(frame, center - cv::Point(half.width, half.height),
+                          center + cv::Point(half.width, half.height), color, cv::FILLED);
+        }
+    }
+    return frame;
+}
+
+// 固定数量的合成检测结果，分布在整幅图内，绘制耗时只与图像尺寸有关
+std::vector<Blade> make_blades(const cv::Size& size, int n)
+{
+    std::mt19937 rng(n);
+    std::uniform_real_distribution<float> x(0.1f, 0.9f);
+    std::uniform_real_distribution<float> prob(0.5f, 1.0f);
+    const float side = std::min(size.width, size.height) / 10.0f;
+
+    std::vector<Blade> blades(n);
+    for (int i = 0; i < n; ++i) {
+        const cv::Point2f center(x(rng) * size.width, x(rng) * size.height);
+        Blade& blade = blades[i];
+        blade.rect = cv::Rect(cv::Point(center.x - side / 2, center.y - side / 2),
+                              cv::Size(side, side));
+        blade.cls = (i % 2 == 0) ? BladeClass::RR : BladeClass::BR;
+        blade.prob = prob(rng);
+        for (int k = 0; k < BLADE_KPT_NUM; ++k) {
+            blade.kpt[k] = center + cv::Point2f((k % 2 ? 0.4f : -0.4f) * side,
+                                                (k / 2 ? 0.4f : -0.4f) * side);
+        }
+    }
+    return blades;
+}
+
+// 聚集在少数目标附近的候选框，模拟真实输出中的大量重叠（与 nms_bench 相同的分布）
+void make_candidates(int n, CandidateBuffer& cand)
+{
+    std::mt19937 rng(n);
+    std::uniform_real_distribution<float> center(50.0f, 590.0f);
+    std::normal_distribution<float> jitter(0.0f, 6.0f);
+    std::uniform_real_distribution<float> size(30.0f, 120.0f);
+    std::uniform_real_distribution<float> score(0.5f, 1.0f);
+
+    const int clusters = std::max(1, n / 10);
+    std::vector<float> cx(clusters), cy(clusters), w(clusters), h(clusters);
+    for (int c = 0; c < clusters; ++c) {
+        cx[c] = center(rng);
+        cy[c] = center(rng);
+        w[c] = size(rng);
+        h[c] = size(rng);
+    }
+
+    cand.clear();
+    cand.reserve(n, 0);
+    for (int i = 0; i < n; ++i) {
+        int c = i % clusters;
+        cand.cx.push_back(cx[c] + jitter(rng));
+        cand.cy.push_back(cy[c] + jitter(rng));
+        cand.w.push_back(w[c] + jitter(rng));
+        cand.h.push_back(h[c] + jitter(rng));
+        cand.score.push_back(score(rng));
+        cand.class_id.push_back(i % 4);
+        cand.batch.push_back(0);
+    }
+}
+
+// 读入视频的前若干帧，读帧耗时记为 decode 阶段
+bool load_video(const QString& path, const BenchOptions& options, InputSet& input,
+                std::vector<StageResult>& results)
+{
+    cv::VideoCapture cap(path.toStdString());
+    if (!cap.isOpened()) {
+        std::fprintf(stderr, "cannot open video: %s\n", qPrintable(path));
+        return false;
+    }
+
+    input.name = QFileInfo(path).fileName().toStdString();
+    input.kind = "video";
+
+    std::vector<double> samples;
+    while (static_cast<int>(input.frames.size()) < options.videoFrames) {
+        cv::Mat frame;
+        auto start = std::chrono::steady_clock::now();
+        if (!cap.read(frame) || frame.empty()) {
+            break;
+        }
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        input.frames.push_back(frame);
+    }
+    if (input.frames.empty()) {
+        std::fprintf(stderr, "no frames decoded: %s\n", qPrintable(path));
+        return false;
+    }
+    input.size = input.frames.front().size();
+
+    results.push_back(summarize(input, "decode", samples));
+    return true;
+}
+
+// 定位耗时（定位 + 读出目标帧）：
+//   seek_random / seek_keyframe  随机帧 / 随机关键帧直接定位
+//   scrub_set / scrub_indexed    每次向后 step 帧，逐次定位 / 按关键帧索引选择定位或继续解码
+void bench_seek(const QString& path, const BenchOptions& options, std::vector<StageResult>& results)
+{
+    KeyframeIndex index;
+    if (!index.build(path.toStdString())) {
+        std::fprintf(stderr, "no keyframe index, seek stages skipped: %s\n", qPrintable(path));
+        return;
+    }
+    cv::VideoCapture cap(path.toStdString());
+    if (!cap.isOpened() || index.frameCount() < 2) {
+        return;
+    }
+
+    InputSet input;
+    input.name = QFileInfo(path).fileName().toStdString();
+    input.kind = "video";
+    input.size = cv::Size(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)),
+                          static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+
+    const int frames = index.frameCount();
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> pick(0, frames - 1);
+    cv::Mat frame;
+
+    results.push_back(measure(options, input, "seek_random", [&](int) {
+        cap.set(cv::CAP_PROP_POS_FRAMES, pick(rng));
+        cap.read(frame);
+    }));
+    results.push_back(measure(options, input, "seek_keyframe", [&](int) {
+        cap.set(cv::CAP_PROP_POS_FRAMES, index.nearestKeyframe(pick(rng)));
+        cap.read(frame);
+    }));
+
+    // 模拟向后拖动进度条，到结尾后从头开始
+    const int step = 5;
+    int target = 0;
+    results.push_back(measure(options, input, "scrub_set", [&](int) {
+        target = (target + step) % frames;
+        cap.set(cv::CAP_PROP_POS_FRAMES, target);
+        cap.read(frame);
+    }));
+    target = 0;
+    int position = -1;
+    results.push_back(measure(options, input, "scrub_indexed", [&](int) {
+        target = (target + step) % frames;
+        if (index.shouldSeek(position, target)) {
+            cap.set(cv::CAP_PROP_POS_FRAMES, target);
+            position = target;
+        }
+        while (position < target && cap.grab()) {
+            ++position;
+        }
+        position = cap.read(frame) ? target + 1 : -1;
+    }));
+}
+
+// 对一组输入逐阶段计时，每次迭代轮流使用其中的一帧
+void bench_input(const BenchOptions& options, const InputSet& input, Detector* detector,
+                 MediaProcessor& processor, std::vector<StageResult>& results)
+{
+    const auto& frames = input.frames;
+    const size_t count = frames.size();
+    auto frame_at = [&](int i) -> const cv::Mat& { return frames[i % count]; };
+
+    if (detector) {
+        StageBench stages(*detector);
+        stages.prepare(frames.front());
+
+        if (stages.hostPreprocess()) {
+            results.push_back(measure(options, input, "letterbox", [&](int i) {
+                stages.letterbox(frame_at(i));
+            }));
+            results.push_back(measure(options, input, "normalize", [&](int) {
+                stages.normalize();
+            }));
+        } else {
+            results.push_back(measure(options, input, "preprocess", [&](int i) {
+                stages.prepare(frame_at(i));
+            }));
+        }
+
+        // 推理和后处理的耗时与帧内容有关（后处理随候选数变化），每次迭代先准备好对应帧的输入
+        // 准备输入不计入这两个阶段
+        std::vector<double> inferSamples, postSamples;
+        inferSamples.reserve(1024);
+        postSamples.reserve(1024);
+        double totalUs = 0.0;
+        size_t inferAllocs = 0, postAllocs = 0;
+        for (int i = -options.warmup; i < 0 || keep_measuring(options, inferSamples.size(), totalUs); ++i) {
+            stages.prepare(frame_at(std::max(i, 0)));
+            const size_t before = g_allocations.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            stages.infer();
+            auto mid = std::chrono::steady_clock::now();
+            const size_t afterInfer = g_allocations.load(std::memory_order_relaxed);
+            stages.postprocess();
+            auto end = std::chrono::steady_clock::now();
+            const size_t afterPost = g_allocations.load(std::memory_order_relaxed);
+            if (i >= 0) {
+                inferAllocs += afterInfer - before;
+                postAllocs += afterPost - afterInfer;
+                const double inferUs = std::chrono::duration<double, std::micro>(mid - start).count();
+                const double postUs = std::chrono::duration<double, std::micro>(end - mid).count();
+                inferSamples.push_back(inferUs);
+                postSamples.push_back(postUs);
+                totalUs += inferUs + postUs;
+            }
+        }
+        results.push_back(summarize(input, "infer", inferSamples, inferAllocs));
+        results.push_back(summarize(input, "postprocess", postSamples, postAllocs));
+
+        // 宏基准：完整的单帧同步检测
+        // 分配数只算主机侧：Detect 之后在同一请求、同一输入上单独推理一次，扣除推理内部的分配
+        std::vector<double> detectSamples;
+        detectSamples.reserve(1024);
+        totalUs = 0.0;
+        size_t hostAllocs = 0;
+        for (int i = -options.warmup; i < 0 || keep_measuring(options, detectSamples.size(), totalUs); ++i) {
+            const size_t before = g_allocations.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            detector->Detect(frame_at(std::max(i, 0)));
+            auto end = std::chrono::steady_clock::now();
+            const size_t afterDetect = g_allocations.load(std::memory_order_relaxed);
+            stages.infer();
+            const size_t inferAllocs = g_allocations.load(std::memory_order_relaxed) - afterDetect;
+            if (i >= 0) {
+                const size_t detectAllocs = afterDetect - before;
+                hostAllocs += detectAllocs > inferAllocs ? detectAllocs - inferAllocs : 0;
+                const double us = std::chrono::duration<double, std::micro>(end - start).count();
+                detectSamples.push_back(us);
+                totalUs += us;
+            }
+        }
+        results.push_back(summarize(input, "detect", detectSamples, hostAllocs));
+
+        // 批量检测（至多 4 帧，结果容器复用）和分块检测（batch 为 1 时各分块经推理请求池并行）
+        const std::vector<cv::Mat> batch(frames.begin(), frames.begin() + std::min<size_t>(4, count));
+        std::vector<std::vector<Blade>> batchResults;
+        results.push_back(measure(options, input, "detect_batch", [&](int) {
+            detector->Detect(batch, batchResults);
+        }));
+        TiledDetector tiled;
+        results.push_back(measure(options, input, "detect_tiled", [&](int i) {
+            tiled.Detect(*detector, frame_at(i));
+        }));
+    }
+
+    const std::vector<Blade> blades = make_blades(input.size, 8);
+    cv::Mat canvas = frames.front().clone();
+    results.push_back(measure(options, input, "draw_blade", [&](int) {
+        Detector::draw_blade(canvas, blades);
+    }));
+
+    results.push_back(measure(options, input, "binary", [&](int i) {
+        StageBench::applyBinary(processor, frame_at(i));
+    }));
+    results.push_back(measure(options, input, "roi", [&](int i) {
+        StageBench::extractROI(processor, frame_at(i));
+    }));
+    results.push_back(measure(options, input, "to_qimage", [&](int i) {
+        StageBench::matToQImage(processor, frame_at(i));
+    }));
+    // 显示线程交给界面的图像：缩放到 1280x720 显示区域内再包装
+    results.push_back(measure(options, input, "to_display", [&](int i) {
+        StageBench::toDisplayImage(processor, frame_at(i));
+    }));
+}
+
+// 不依赖图像的 NMS 微基准：10 / 100 / 1000 个候选
+void bench_nms(const BenchOptions& options, float iouThres, std::vector<StageResult>& results)
+{
+    for (int n : {10, 100, 1000}) {
+        InputSet input;
+        input.name = "candidates_" + std::to_string(n);
+        input.kind = "candidates";
+
+        CandidateBuffer cand;
+        make_candidates(n, cand);
+        NmsWorkspace ws;
+        ws.reserve(n);
+        std::vector<int> keep;
+        keep.reserve(n);
+        NmsOptions opts;
+        opts.iou_thres = iouThres;
+
+        opts.class_agnostic = true;
+        results.push_back(measure(options, input, "nms_agnostic", [&](int) {
+            non_max_suppression(cand, opts, ws, keep);
+        }));
+        opts.class_agnostic = false;
+        results.push_back(measure(options, input, "nms_per_class", [&](int) {
+            non_max_suppression(cand, opts, ws, keep);
+        }));
+    }
+}
+
+std::string json_escape(const std::string& text)
+{
+    std::string out;
+    out.reserve(text.size() + 2);
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+std::string compiler_name()
+{
+#if defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+void write_json(FILE* out, const BenchOptions& options, const Detector* detector,
+                const std::vector<StageResult>& results)
+{
+    const std::string timestamp =
+        QDateTime::currentDateTimeUtc().toString(Qt::ISODate).toStdString();
+
+    std::fprintf(out, "{\n");
+    std::fprintf(out, "  \"benchmark\": \"Detection_bench\",\n");
+    std::fprintf(out, "  \"timestamp\": \"%s\",\n", timestamp.c_str());
+    std::fprintf(out, "  \"environment\": {\n");
+    std::fprintf(out, "    \"compiler\": \"%s\",\n", json_escape(compiler_name()).c_str());
+#ifdef NDEBUG
+    std::fprintf(out, "    \"build_type\": \"release\",\n");
+#else
+    std::fprintf(out, "    \"build_type\": \"debug\",\n");
+#endif
+    std::fprintf(out, "    \"opencv\": \"%s\",\n", CV_VERSION);
+    std::fprintf(out, "    \"openvino\": \"%s\",\n",
+                 json_escape(ov::get_openvino_version().buildNumber).c_str());
+    std::fprintf(out, "    \"qt\": \"%s\",\n", qVersion());
+    std::fprintf(out, "    \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    std::fprintf(out, "    \"opencv_threads\": %d\n", cv::getNumThreads());
+    std::fprintf(out, "  },\n");
+
+    if (detector) {
+        std::fprintf(out, "  \"detector\": {\n");
+        std::fprintf(out, "    \"model\": \"%s\",\n", json_escape(detector->getModelPath()).c_str());
+        std::fprintf(out, "    \"device\": \"%s\",\n", json_escape(detector->getDevice()).c_str());
+        std::fprintf(out, "    \"input_size\": %d,\n", detector->getInputSize());
+        std::fprintf(out, "    \"graph_preprocess\": %s\n",
+                     options.graphPreprocess ? "true" : "false");
+        std::fprintf(out, "  },\n");
+    } else {
+        std::fprintf(out, "  \"detector\": null,\n");
+    }
+
+    std::fprintf(out, "  \"min_time_ms\": %.1f,\n", options.minTimeMs);
+    std::fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const StageResult& r = results[i];
+        char allocs[32] = "null";
+        if (r.allocsPerIter >= 0) {
+            std::snprintf(allocs, sizeof(allocs), "%.3f", r.allocsPerIter);
+        }
+        std::fprintf(out,
+                     "    {\"input\": \"%s\", \"kind\": \"%s\", \"width\": %d, \"height\": %d, "
+                     "\"stage\": \"%s\", \"iterations\": %d, \"mean_us\": %.3f, \"min_us\": %.3f, "
+                     "\"p50_us\": %.3f, \"p95_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, "
+                     "\"allocs_per_iter\": %s}%s\n",
+                     json_escape(r.input).c_str(), r.kind.c_str(), r.size.width, r.size.height,
+                     r.stage.c_str(), r.iterations, r.meanUs, r.minUs,
+                     r.p50Us, r.p95Us, r.p99Us, r.maxUs, allocs,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n");
+    std::fprintf(out, "}\n");
+}
+
+bool parse_sizes(const QString& text, std::vector<cv::Size>& sizes)
+{
+    sizes.clear();
+    for (const QString& item : text.split(',')) {
+        if (item.trimmed().isEmpty()) {
+            continue;
+        }
+        const QStringList parts = item.trimmed().split('x');
+        bool okW = false, okH = false;
+        const int w = parts.size() == 2 ? parts[0].toInt(&okW) : 0;
+        const int h = parts.size() == 2 ? parts[1].toInt(&okH) : 0;
+        if (!okW || !okH || w <= 0 || h <= 0) {
+            return false;
+        }
+        sizes.emplace_back(w, h);
+    }
+    return true;
+}
+
+bool parse_options(const QCoreApplication& app, BenchOptions& options, QString& error)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Per-stage detection benchmark, results as JSON");
+    parser.addHelpOption();
+    parser.addPositionalArgument("videos", "Recorded videos to benchmark on.", "[videos...]");
+
+    QCommandLineOption modelOption("model", "Detection model (.xml), or \"none\".", "path",
+                                   options.modelPath);
+    QCommandLineOption videoOption("video", "Recorded video (repeatable).", "path");
+    QCommandLineOption framesOption("frames", "Frames read from each video.", "n",
+                                    QString::number(options.videoFrames));
+    QCommandLineOption sizesOption("sizes", "Synthetic frame sizes, empty to skip.", "WxH,...",
+                                   "640x480,1280x720,1920x1080,3840x2160");
+    QCommandLineOption timeOption("min-time-ms", "Minimum measured time per stage.", "ms",
+                                  QString::number(options.minTimeMs));
+    QCommandLineOption warmupOption("warmup", "Warm-up iterations per stage.", "n",
+                                    QString::number(options.warmup));
+    QCommandLineOption inputSizeOption("input-size", "Network input size.", "n",
+                                       QString::number(options.inputSize));
+    QCommandLineOption gpuOption("gpu", "Try compiling on GPU first.");
+    QCommandLineOption graphOption("graph-preprocess", "Letterbox / normalize inside the model.");
+    QCommandLineOption outOption({"o", "out"}, "Output JSON file (default stdout).", "path");
+    QCommandLineOption checkAllocOption("check-allocations",
+                                        "Exit with status 3 if a host-side steady-state stage allocates.");
+    parser.addOptions({modelOption, videoOption, framesOption, sizesOption, timeOption,
+                       warmupOption, inputSizeOption, gpuOption, graphOption, outOption,
+                       checkAllocOption});
+    parser.process(app);
+
+    bool ok = true;
+    auto number = [&](const QCommandLineOption& option, int minimum) {
+        bool valid = false;
+        const int value = parser.value(option).toInt(&valid);
+        if (!valid || value < minimum) {
+            error = QString("invalid --%1: %2").arg(option.names().last(), parser.value(option));
+            ok = false;
+        }
+        return value;
+    };
+
+    options.modelPath = parser.value(modelOption);
+    options.videos = parser.values(videoOption) + parser.positionalArguments();
+    options.videoFrames = number(framesOption, 1);
+    options.warmup = number(warmupOption, 0);
+    options.inputSize = number(inputSizeOption, 32);
+    options.minTimeMs = parser.value(timeOption).toDouble();
+    options.tryGpu = parser.isSet(gpuOption);
+    options.graphPreprocess = parser.isSet(graphOption);
+    options.outputPath = parser.value(outOption);
+    options.checkAllocations = parser.isSet(checkAllocOption);
+    if (!parse_sizes(parser.value(sizesOption), options.sizes)) {
+        error = "invalid --sizes: " + parser.value(sizesOption);
+        return false;
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("BuffDetection");
+    QCoreApplication::setOrganizationName("flairziv");
+
+    static CountingMatAllocator matAllocator(cv::Mat::getDefaultAllocator());
+    cv::Mat::setDefaultAllocator(&matAllocator);
+
+    BenchOptions options;
+    QString error;
+    if (!parse_options(app, options, error)) {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 2;
+    }
+
+    std::unique_ptr<Detector> detector;
+    if (options.modelPath != "none") {
+        try {
+            QString xmlPath;
+            if (!MediaProcessor::resolveModelFiles(options.modelPath, "buff_model", xmlPath, &error)) {
+                std::fprintf(stderr, "%s\n", qPrintable(error));
+                return 2;
+            }
+            DetectorConfig config;
+            config.input_size = options.inputSize;
+            config.try_gpu = options.tryGpu;
+            config.graph_preprocess = options.graphPreprocess;
+            detector.reset(new Detector(xmlPath.toStdString(), config));
+        } catch (const std::exception& e) {
+            std::fprintf(stderr, "failed to load model: %s\n", e.what());
+            return 2;
+        }
+    }
+
+    MediaProcessor processor;
+    processor.setDisplayBounds(QSize(1280, 720));
+    std::vector<StageResult> results;
+
+    for (const cv::Size& size : options.sizes) {
+        InputSet input;
+        input.name = "synthetic_" + std::to_string(size.width) + "x" + std::to_string(size.height);
+        input.kind = "synthetic";
+        input.size = size;
+        for (int i = 0; i < 4; ++i) {
+            input.frames.push_back(make_frame(size, i));
+        }
+        bench_input(options, input, detector.get(), processor, results);
+    }
+
+    int failed = 0;
+    for (const QString& path : options.videos) {
+        InputSet input;
+        if (!load_video(path, options, input, results)) {
+            ++failed;
+            continue;
+        }
+        bench_input(options, input, detector.get(), processor, results);
+        bench_seek(path, options, results);
+    }
+
+    bench_nms(options, detector ? detector->getNMSThreshold() : 0.4f, results);
+
+    FILE* out = stdout;
+    if (!options.outputPath.isEmpty()) {
+        out = std::fopen(options.outputPath.toLocal8Bit().constData(), "w");
+        if (!out) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(options.outputPath));
+            return 2;
+        }
+    }
+    write_json(out, options, detector.get(), results);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+
+    if (options.checkAllocations) {
+        bool allocated = false;
+        for (const StageResult& r : results) {
+            for (const char* stage : kAllocationFreeStages) {
+                if (r.stage == stage && r.allocsPerIter > 0) {
+                    std::fprintf(stderr, "steady-state allocation: %s %s %.2f per iteration\n",
+                                 r.input.c_str(), r.stage.c_str(), r.allocsPerIter);
+                    allocated = true;
+                }
+            }
+        }
+        if (allocated) {
+            return 3;
+        }
+    }
+
+    return failed > 0 ? 1 : 0;
+}
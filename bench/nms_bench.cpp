@@ -0,0 +1,113 @@
+// NMS 微基准：内置浮点 NMS 与 cv::dnn::NMSBoxes 在 10 / 100 / 1000 个候选下的耗时对比
+#include "postprocess.h"
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace rm_buff;
+
+namespace
+{
+
+// 生成聚集在少数目标附近的候选框，模拟真实输出中的大量重叠
+void make_candidates(int n, CandidateBuffer& cand)
+{
+    std::mt19937 rng(n);
+    std::uniform_real_distribution<float> center(50.0f, 590.0f);
+    std::normal_distribution<float> jitter(0.0f, 6.0f);
+    std::uniform_real_distribution<float> size(30.0f, 120.0f);
+    std::uniform_real_distribution<float> score(0.5f, 1.0f);
+
+    const int clusters = std::max(1, n / 10);
+    std::vector<float> cx(clusters), cy(clusters), w(clusters), h(clusters);
+    for (int c = 0; c < clusters; ++c) {
+        cx[c] = center(rng);
+        cy[c] = center(rng);
+        w[c] = size(rng);
+        h[c] = size(rng);
+    }
+
+    cand.clear();
+    cand.reserve(n, 0);
+    for (int i = 0; i < n; ++i) {
+        int c = i % clusters;
+        cand.cx.push_back(cx[c] + jitter(rng));
+        cand.cy.push_back(cy[c] + jitter(rng));
+        cand.w.push_back(w[c] + jitter(rng));
+        cand.h.push_back(h[c] + jitter(rng));
+        cand.score.push_back(score(rng));
+        cand.class_id.push_back(i % 4);
+        cand.batch.push_back(0);
+    }
+}
+
+template <typename Fn>
+double time_us(int iterations, Fn&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+} // namespace
+
+int main()
+{
+    const float conf_thres = 0.5f;
+    const float iou_thres = 0.4f;
+
+    std::printf("%-8s %14s %14s %14s %8s\n",
+                "count", "opencv_us", "agnostic_us", "per_class_us", "kept");
+
+    for (int n : {10, 100, 1000}) {
+        CandidateBuffer cand;
+        make_candidates(n, cand);
+        const int iterations = n <= 100 ? 20000 : 500;
+
+        // 原实现：转为整数 cv::Rect 后调用 cv::dnn::NMSBoxes
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        std::vector<int> picked;
+        double opencv_us = time_us(iterations, [&] {
+            boxes.clear();
+            scores.clear();
+            for (size_t i = 0; i < cand.size(); ++i) {
+                boxes.emplace_back(cv::Rect(cand.cx[i] - cand.w[i] / 2.0f,
+                                            cand.cy[i] - cand.h[i] / 2.0f,
+                                            cand.w[i], cand.h[i]));
+                scores.emplace_back(cand.score[i]);
+            }
+            cv::dnn::NMSBoxes(boxes, scores, conf_thres, iou_thres, picked);
+        });
+
+        NmsWorkspace ws;
+        ws.reserve(n);
+        std::vector<int> keep;
+        keep.reserve(n);
+        NmsOptions opts;
+        opts.iou_thres = iou_thres;
+
+        opts.class_agnostic = true;
+        double agnostic_us = time_us(iterations, [&] {
+            non_max_suppression(cand, opts, ws, keep);
+        });
+        size_t kept = keep.size();
+
+        opts.class_agnostic = false;
+        double per_class_us = time_us(iterations, [&] {
+            non_max_suppression(cand, opts, ws, keep);
+        });
+
+        std::printf("%-8d %14.2f %14.2f %14.2f %5zu/%zu\n",
+                    n, opencv_us, agnostic_us, per_class_us, kept, picked.size());
+    }
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffdetector.h"
+
+class QCoreApplication;
+
+// 批量处理选项（命令行 --batch 模式）
+struct BatchOptions {
+    QStringList inputs;                         // 图片 / 视频文件或目录（目录递归查找）
+    QString outputPath = "results.jsonl";       // "-" 为标准输出
+    QString modelPath = ":/models/buff.xml";
+    QString armorModelPath;                     // 为空时不检测装甲板
+    int jobs = 0;                               // 工作线程数，0 为 CPU 逻辑核心数
+    int frameStep = 1;                          // 视频每 N 帧处理一帧
+    double confidence = 0.5;
+    double nms = 0.4;
+    int inputSize = 640;
+
+    // 解析命令行；--help / --version 时直接退出进程，参数错误时返回 false 并给出原因
+    static bool parse(const QCoreApplication& app, BatchOptions& options, QString& error);
+};
+
+// 无界面批量检测：工作线程各自取一个文件解码，提交到以吞吐模式编译、共享推理请求池的检测器
+// 每个工作线程保留若干帧在途，单个长视频也能占满推理流
+// 每帧一行 JSON 写入输出文件（不同文件的行可能交错，每行自带文件名和帧号），结束时打印吞吐统计
+class BatchRunner
+{
+public:
+    explicit BatchRunner(const BatchOptions& options);
+    ~BatchRunner();
+
+    // 处理全部输入，返回进程退出码：0 全部成功，1 有文件失败，2 无法开始
+    int run();
+
+private:
+    struct FileStats {
+        int64_t frames = 0;
+        int64_t detections = 0;
+        bool ok = false;
+        QString error;
+    };
+
+    bool loadDetectors(QString& error);
+    QStringList collectFiles() const;
+    static bool isImageFile(const QString& path);
+
+    void worker();
+    FileStats processImage(const QString& path);
+    FileStats processVideo(const QString& path);
+    void writeFrame(const QString& path, int frame, double timestampMs,
+                    const std::vector<rm_buff::Blade>& blades);
+    void reportFile(const QString& path, const FileStats& stats, double seconds);
+
+    BatchOptions options_;
+    QStringList files_;
+    int jobs_ = 1;
+    int inflight_ = 1;                          // 每个工作线程的在途帧数
+
+    std::unique_ptr<rm_buff::Detector> detector_;
+    std::unique_ptr<rm_buff::Detector> armorDetector_;
+
+    QFile output_;
+    std::mutex outputMutex_;
+
+    std::atomic<int> nextFile_;
+    std::atomic<int> finishedFiles_;
+    std::atomic<int> failedFiles_;
+    std::atomic<int64_t> totalFrames_;
+    std::atomic<int64_t> totalDetections_;
+};
+
+#endif // BATCHRUNNER_H
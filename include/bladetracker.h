@@ -0,0 +1,52 @@
+#ifndef BLADETRACKER_H
+#define BLADETRACKER_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "buffdetector.h"
+
+namespace rm_buff
+{
+
+// 跟踪参数
+struct TrackerConfig {
+    int full_detect_interval = 10;  // 每隔多少帧做一次整帧检测
+    int min_crop_size = 640;        // 裁剪区域最小边长，不小于网络输入时裁剪区域无需缩小
+    float crop_margin = 0.3f;       // 在预测区域四周按其尺寸比例外扩
+};
+
+// 能量机关跟踪器：扇叶绕中心旋转，整体外接框几乎不动
+// 用上一帧所有扇叶的外接框按匀速运动外推，作为下一帧的裁剪检测区域
+class BladeTracker
+{
+public:
+    explicit BladeTracker(const TrackerConfig& config = TrackerConfig());
+
+    void reset();
+
+    // 本帧是否需要整帧检测（首帧、到达间隔或跟踪丢失）
+    bool needFullDetect() const;
+
+    // 预测本帧的裁剪区域（原图坐标），已裁剪到图像范围内
+    cv::Rect predictRoi(const cv::Size& frame_size) const;
+
+    // 用本帧检测结果更新跟踪状态；roi 为本帧检测区域，整帧检测时为整幅图像
+    void update(const std::vector<Blade>& blades, const cv::Rect& roi, bool full_frame);
+
+    bool isTracking() const { return tracking_; }
+
+    void setConfig(const TrackerConfig& config) { config_ = config; }
+    const TrackerConfig& getConfig() const { return config_; }
+
+private:
+    TrackerConfig config_;
+    bool tracking_ = false;
+    int frames_since_full_ = 0;
+    cv::Rect2f bounds_;             // 上一帧所有扇叶的外接框
+    cv::Point2f velocity_;          // 外接框中心的帧间位移
+};
+
+} // namespace rm_buff
+
+#endif // BLADETRACKER_H
@@ -3,36 +3,187 @@
 
 #include <opencv2/opencv.hpp>
 #include <openvino/openvino.hpp>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 
+#include "postprocess.h"
+
 namespace rm_buff
 {
 
-// 检测结果结构
+// 每个目标的关键点数量
+constexpr int BLADE_KPT_NUM = 4;
+
+// 目标类别：能量机关与装甲板模型的类别统一编号，检测头类别下标加上模型的起始值
+enum class BladeClass : uint8_t {
+    RR, RW, BR, BW,                 // 能量机关：红/蓝 已激活(R)/待激活(W)
+    Blue, Red, Gray, Purple         // 装甲板
+};
+
+// 类别名称（静态字符串）
+const char* class_name(BladeClass cls);
+
+// 待激活扇叶，不绘制
+inline bool is_inactive(BladeClass cls) { return cls == BladeClass::RW || cls == BladeClass::BW; }
+
+// 检测结果结构，定长且不持有堆内存，可直接按值拷贝和跨线程传递
 struct Blade {
-    cv::Rect rect;                  // 边界框
-    std::string label;              // 类别标签
-    float prob;                     // 置信度
-    std::vector<cv::Point2f> kpt;   // 关键点
+    cv::Rect rect;                                  // 边界框
+    BladeClass cls;                                 // 类别
+    float prob;                                     // 置信度
+    std::array<cv::Point2f, BLADE_KPT_NUM> kpt;     // 关键点，无效点为 (-1, -1)
+};
+
+// Letterbox 变换参数（用于将网络坐标映射回原图）
+struct LetterboxInfo {
+    float padd_w = 0.0f;            // 左右单侧填充
+    float padd_h = 0.0f;            // 上下单侧填充
+    cv::Size src_size;              // 原图尺寸
+};
+
+// 推理性能模式
+enum class PerformanceMode {
+    Latency,        // 低延迟：单帧尽快返回，适合实时视频
+    Throughput      // 高吞吐：多推理流并行，适合多线程批量处理录像
+};
+
+// 模型类型，决定检测头布局和类别名
+enum class ModelType {
+    Buff,           // 能量机关：RR/RW/BR/BW
+    Armor           // 装甲板：BLUE/RED/GRAY/PURPLE
+};
+
+// 推理精度
+enum class InferencePrecision {
+    Default,        // 设备默认精度
+    FP32,
+    BF16,           // 需要 CPU 支持 AVX512-BF16/AMX，否则回退 FP32
+    FP16,
+    INT8            // 加载 NNCF 量化后的 *_int8.xml 模型
+};
+
+// 检测器配置
+struct DetectorConfig {
+    ModelType model_type = ModelType::Buff;
+    PerformanceMode performance_mode = PerformanceMode::Latency;
+    int num_streams = 0;            // 吞吐模式的推理流数量，0 由设备自动决定
+    int async_requests = 2;         // 异步流水线的推理请求数（2 为双缓冲，3 为三缓冲），吞吐模式下不少于设备建议的请求数
+    bool graph_preprocess = false;  // 输入原始 u8 BGR 图像，letterbox/归一化/布局转换在 OpenVINO 图中完成
+    bool nms_class_agnostic = true; // true 为跨类别 NMS，false 为按类别分别 NMS
+    int max_det = 300;              // 每张图最多保留的目标数
+    int batch_size = 1;             // 模型 batch 大小，批量检测按此分块；<= 0 为动态 batch
+    int input_size = 640;           // 网络输入边长（32 的倍数），加载时 reshape 模型；320 约为 640 计算量的 1/4
+    std::string cache_dir;          // 编译模型缓存目录（需已存在），为空时不缓存
+    bool try_gpu = true;            // 是否先尝试在 GPU 上编译，无 GPU 的机器可关闭以节省启动时间
+    InferencePrecision precision = InferencePrecision::Default;
 };
 
+// 分阶段基准测试（bench/detection_bench.cpp）直接调用检测器和 MediaProcessor 的内部阶段
+class StageBench;
+
 // 检测器类
 class Detector
 {
+    friend class StageBench;
+
 public:
-    explicit Detector(const std::string& model_path);
-    ~Detector() = default;
+    // 异步检测完成回调（在 OpenVINO 的回调线程中调用）
+    // 推理或后处理失败时 error 非空、结果为空，以便与无检测结果的帧区分
+    using DetectCallback = std::function<void(std::vector<Blade>, std::exception_ptr error)>;
+
+    // core 为空时创建独立的 ov::Core；多个检测器可共享同一个 Core
+    explicit Detector(const std::string& model_path,
+                      const DetectorConfig& config = DetectorConfig(),
+                      std::shared_ptr<ov::Core> core = nullptr);
+    ~Detector();
+
+    // 执行检测，返回的引用在下一次调用前有效
+    // 所有缓冲区在加载模型时分配，稳态下不再申请堆内存
+    const std::vector<Blade>& Detect(const cv::Mat& src_img);
+
+    // 只在 roi 区域内检测（roi 会被裁剪到图像范围），结果映射回原图坐标
+    const std::vector<Blade>& Detect(const cv::Mat& src_img, const cv::Rect& roi);
+
+    // 批量检测：按模型 batch 大小分块推理，每张图使用各自的 letterbox 参数映射回原图
+    // 图内预处理模式下同一块内的图像尺寸必须一致，尺寸变化处自动切块
+    // 结果按下标写入 results 并复用其中已有的容量，图数不变时稳态下不申请堆内存
+    void Detect(const std::vector<cv::Mat>& src_imgs, std::vector<std::vector<Blade>>& results);
+    // 同上，每次返回新的结果容器（每次调用都会分配）
+    std::vector<std::vector<Blade>> Detect(const std::vector<cv::Mat>& src_imgs);
+
+    // 线程安全的同步检测：从推理请求池中借出一个空闲请求，多个工作线程可同时调用
+    // 池中请求全部占用时阻塞，结果写入 blades
+    void Detect(const cv::Mat& src_img, std::vector<Blade>& blades);
+
+    // 异步检测：预处理在调用线程完成后立即返回，推理结束后在回调线程中做 NMS
+    // 所有推理请求都在使用中时阻塞，直到有请求空闲
+    // 结果按值交出，每个请求都会分配结果数组（future 版本另有共享状态）；逐帧循环应使用 DetectPooled
+    void DetectAsync(const cv::Mat& src_img, DetectCallback callback);
+    std::future<std::vector<Blade>> DetectAsync(const cv::Mat& src_img);
 
-    // 执行检测
-    std::vector<Blade> Detect(cv::Mat& src_img);
+    // 等待所有异步请求完成，且其回调都已返回
+    void WaitAll();
+
+    // 分阶段检测：StartDetect 预处理并启动推理后立即返回，WaitDetect 等待并取结果
+    // 多个检测器可以在同一帧上同时推理；与 Detect(const cv::Mat&) 共用同步推理槽，不能交叉调用
+    void StartDetect(const cv::Mat& src_img);
+    const std::vector<Blade>& WaitDetect();
+
+    // 输入尺寸、预处理方式和 batch 一致时，可以直接使用另一个检测器预处理好的输入张量
+    bool CanShareInput(const Detector& other) const;
+
+    // 使用 source 最近一次 StartDetect 的输入启动推理（source 的推理须尚未被下一帧覆盖）
+    void StartDetectShared(Detector& source);
+
+    // 推理请求池大小
+    int poolSize() const { return static_cast<int>(slots_.size()); }
 
     // 绘制检测结果
     void draw_blade(cv::Mat& img);
+    static void draw_blade(cv::Mat& img, const std::vector<Blade>& blades);
 
     // 获取最新的检测结果
     const std::vector<Blade>& getBladeArray() const { return blade_array_; }
 
+    // 同步检测各阶段的耗时（毫秒）
+    struct StageTimings {
+        double preprocess_ms = 0.0;     // letterbox + 归一化写入张量（图内预处理时只包装原图）
+        double infer_ms = 0.0;          // 推理；分阶段检测时为启动到等待结束
+        double postprocess_ms = 0.0;    // 解码 + NMS + 映射回原图
+    };
+
+    // 最近一次同步检测（Detect / WaitDetect）的阶段耗时，批量检测为各块之和
+    const StageTimings& getLastTimings() const { return sync_slot_.timings; }
+
+    // 多张图并行检测：逐张提交到推理请求池，全部完成后返回，第 i 张的结果写入 outs[i]
+    // 预处理在调用线程进行，与其他请求的推理重叠；结果不经过 future / 回调，outs 容量足够时不分配内存
+    // timings 不为空时写入各请求的阶段耗时之和；同一检测器同时只能有一个线程调用
+    void DetectPooled(const cv::Mat* srcs, int n, std::vector<Blade>* outs,
+                      StageTimings* timings = nullptr);
+
+    const DetectorConfig& getConfig() const { return config_; }
+
+    // 网络输入边长
+    int getInputSize() const { return input_size_; }
+
+    // 实际使用的推理设备（"GPU" 或 "CPU"）
+    const std::string& getDevice() const { return device_; }
+
+    // 实际加载的模型文件（INT8 时为量化模型）
+    const std::string& getModelPath() const { return model_path_; }
+
+    // 指定精度对应的模型文件：INT8 为同目录下的 <name>_int8.xml，其余为原模型
+    static std::string modelPathFor(const std::string& model_path, InferencePrecision precision);
+
     // 设置检测参数
     void setConfThreshold(float conf) { conf_threshold_ = conf; }
     void setNMSThreshold(float nms) { nms_threshold_ = nms; }
@@ -40,42 +191,197 @@ public:
     float getConfThreshold() const { return conf_threshold_; }
     float getNMSThreshold() const { return nms_threshold_; }
 
+    // 候选缓存：下限大于 0 时，单图同步检测（Detect 整图 / ROI、WaitDetect）按 min(下限, 置信度阈值)
+    // 解码并保留 NMS 前的候选；之后只改阈值时用 Refilter 重新筛选，不必再推理
+    void setCandidateFloor(float floor);
+    float getCandidateFloor() const { return candidate_floor_; }
+    // 有缓存的候选且其解码阈值不高于当前置信度阈值
+    bool CanRefilter() const;
+    // 对缓存的候选按当前阈值重新筛选、NMS 并映射回原图，结果写入 getBladeArray()
+    const std::vector<Blade>& Refilter();
+
 private:
-    // Letterbox 图像预处理
-    cv::Mat letterbox(cv::Mat& src, int h, int w);
+    // 后处理暂存区，加载模型时按 anchor 总数预留
+    struct NmsScratch {
+        CandidateBuffer candidates;
+        NmsWorkspace nms;
+        std::vector<int> keep;
+
+        void reserve(size_t n) {
+            candidates.reserve(n, BLADE_KPT_NUM);
+            nms.reserve(n);
+            keep.reserve(n);
+        }
+    };
+
+    // 推理槽：一个推理请求及其独占的缓冲区（batch 中每张图一份）
+    struct InferSlot {
+        ov::InferRequest request;
+        std::vector<cv::Mat> canvas;            // letterbox 画布（u8，网络输入尺寸）
+        std::vector<LetterboxInfo> canvas_lb;   // 画布当前填充边框对应的参数
+        std::vector<cv::Mat> input;             // 指向请求输入张量内存的 float 图像
+        cv::Mat frame;              // 图内预处理模式下拷贝的原图（batch 纵向拼接）
+        ov::Tensor frame_tensor;    // 图内预处理模式下包装原图的输入张量
+        int frame_batch = 0;        // frame_tensor 包装的图像数
+        cv::Size frame_size;        // frame_tensor 包装的单张图尺寸
+        ov::Tensor own_input;       // 主机预处理模式下请求自己的输入张量
+        bool input_shared = false;  // 当前输入是否借用了其他检测器的张量
+        std::vector<LetterboxInfo> lb;
+        NmsScratch scratch;
+        float conf_thres = 0.0f;
+        float iou_thres = 0.0f;
+        std::function<void(std::vector<Blade>, std::exception_ptr)> done;
+        std::vector<Blade>* out = nullptr;  // DetectPooled 的结果位置，非空时不调用 done
+        bool busy = false;
+        StageTimings timings;                           // 最近一次同步推理的阶段耗时
+        std::chrono::steady_clock::time_point started;  // StartDetect 启动推理的时刻
+    };
+
+    // 创建推理请求并分配槽内缓冲区
+    void init_slot(InferSlot& slot);
+
+    // 确保输入张量能容纳 n 张图，并绑定各图像的 float 视图和 letterbox 画布
+    void bind_input_views(InferSlot& slot, int n);
+
+    // 在指定槽上同步推理 n 张图，结果写入 outs[0..n)
+    void run_batch(InferSlot& slot, const cv::Mat* const* srcs, int n,
+                   std::vector<Blade>* outs);
+
+    // Letterbox 图像预处理，直接写入预分配的画布
+    void letterbox(const cv::Mat& src, cv::Mat& canvas, LetterboxInfo& lb,
+                   LetterboxInfo& canvas_lb) const;
+
+    // 计算 letterbox 的填充量（不处理图像）
+    LetterboxInfo letterbox_info(const cv::Size& src_size, int h, int w) const;
+
+    // 预处理 n 张图并写入槽的输入张量
+    // 主机模式下 letterbox + 归一化；图内预处理模式下只包装原图（copy_frames 时先拷贝）
+    void prepare_inputs(InferSlot& slot, const cv::Mat* const* srcs, int n, bool copy_frames);
+
+    // 在同步槽上预处理并推理一张图（候选缓存路径），记录两个阶段的耗时
+    void infer_sync(const cv::Mat* src);
 
-    // NMS 后处理
+    // 同步槽最近一次单图推理的候选
+    struct CandidateCache {
+        CandidateBuffer candidates;     // 网络坐标
+        LetterboxInfo lb;
+        cv::Point offset;               // ROI 检测时区域的左上角
+        float threshold = 0.0f;         // 解码时使用的阈值
+        bool valid = false;
+    };
+
+    // 把同步槽的输出按下限解码进候选缓存，再按当前阈值筛选出结果
+    const std::vector<Blade>& detect_cached(const cv::Point& offset);
+
+    // NMS 后处理，第 b 张图的结果按 lbs[b] 映射回原图后写入 outs[b]
     void non_max_suppression(
-        ov::Tensor& output,
+        const ov::Tensor& output,
+        int num_images,
         float conf_thres,
         float iou_thres,
-        cv::Size img_size
-    );
+        const LetterboxInfo* lbs,
+        NmsScratch& scratch,
+        std::vector<Blade>* outs
+    ) const;
+    // 对 scratch.candidates 中已解码的候选做 NMS 并映射回原图
+    void finish_detections(int num_images, float iou_thres, const LetterboxInfo* lbs,
+                           NmsScratch& scratch, std::vector<Blade>* outs) const;
+
+    // 从请求池借出空闲槽（全部占用时等待）和归还
+    InferSlot& acquire_slot();
+    void release_slot(InferSlot& slot);
+    // 异步请求启动前登记，回调返回后注销；WaitAll 以此判断回调线程已离开检测器
+    void begin_callback();
+    void end_callback();
+
+    // 借出期间独占推理槽，析构时自动归还
+    class SlotLease {
+    public:
+        explicit SlotLease(Detector& detector)
+            : detector_(detector), slot_(detector.acquire_slot()) {}
+        ~SlotLease() { detector_.release_slot(slot_); }
+        SlotLease(const SlotLease&) = delete;
+        SlotLease& operator=(const SlotLease&) = delete;
+
+        InferSlot& slot() { return slot_; }
+
+    private:
+        Detector& detector_;
+        InferSlot& slot_;
+    };
+
+    // 按性能模式生成编译参数
+    ov::AnyMap compile_properties() const;
+
+    // 读取模型并构建预处理，返回待编译的模型
+    std::shared_ptr<ov::Model> build_model();
+
+    // 编译缓存：键由模型文件哈希、预处理/编译配置和 OpenVINO 版本组成，每个设备一个文件
+    std::string cache_key() const;
+    std::string cache_path(const std::string& key, const std::string& device) const;
+    bool import_cached(const std::string& key, const std::string& device,
+                       const ov::AnyMap& properties);
+    void export_cached(const std::string& key) const;
+
+    void submit(const cv::Mat& src_img,
+                std::function<void(std::vector<Blade>, std::exception_ptr)> done);
+    void onSlotFinished(InferSlot& slot, std::exception_ptr error);
+    // DetectPooled 的请求完成：后处理写入 slot.out，累计耗时
+    void finish_pooled(InferSlot& slot, std::exception_ptr error);
 
     // OpenVINO 相关
     std::string model_path_;
-    ov::Core core_;
+    DetectorConfig config_;
+    std::shared_ptr<ov::Core> core_;
     std::shared_ptr<ov::Model> model_;
     ov::CompiledModel compiled_model_;
-    ov::InferRequest infer_request_;
-    ov::Tensor input_tensor_;
+    std::string device_;
+
+    // 同步检测使用的推理槽
+    InferSlot sync_slot_;
+
+    // 推理请求池：异步检测和线程安全的同步检测共用
+    std::vector<std::unique_ptr<InferSlot>> slots_;
+    std::mutex slot_mutex_;
+    std::condition_variable slot_cv_;
+    int callbacks_in_flight_ = 0;   // 已启动但回调尚未返回的异步请求数，受 slot_mutex_ 保护
+
+    // DetectPooled 进行中的请求数和累计耗时
+    struct PooledState {
+        std::mutex mutex;
+        std::condition_variable cv;
+        int pending = 0;
+        StageTimings timings;
+        std::exception_ptr error;
+    };
+    PooledState pooled_;
 
     // 图像处理参数
-    static constexpr int buff_image_size = 640;
-    float padd_w_ = 0.0f;
-    float padd_h_ = 0.0f;
+    int input_size_;
+    int num_anchors_ = 0;   // 输出的 anchor 数，加载时从模型输出形状读取
 
     // 检测参数
     float conf_threshold_ = 0.5f;
     float nms_threshold_ = 0.4f;
+    float candidate_floor_ = 0.0f;
+    CandidateCache candidate_cache_;
+
+    // 检测头解码函数，加载时按模型类型选定
+    using DecodeFn = void (*)(const float* data, int bs, int num_anchors,
+                              float conf_thres, float input_size, CandidateBuffer& out);
+    DecodeFn decode_fn_ = nullptr;
 
-    // 类别定义
-    static constexpr int CLS_NUM = 4;
-    static constexpr int KPT_NUM = 4;
-    const std::vector<std::string> class_names = {"RR", "RW", "BR", "BW"};
+    // 类别定义：检测头类别下标 + class_base_ 即为 BladeClass
+    static constexpr int KPT_NUM = BLADE_KPT_NUM;
+    int class_base_ = 0;
 
     // 检测结果
     std::vector<Blade> blade_array_;
+
+    // 批量检测的分块缓冲：本块的输入、在 results 中的下标和各图结果
+    std::vector<const cv::Mat*> batch_srcs_;
+    std::vector<size_t> batch_index_;
+    std::vector<std::vector<Blade>> batch_outs_;
 };
 
 } // namespace rm_buff
@@ -0,0 +1,35 @@
+#ifndef DETECTIONOVERLAY_H
+#define DETECTIONOVERLAY_H
+
+#include <QImage>
+#include <QPainter>
+#include <QStringList>
+
+#include "detectionresult.h"
+
+// 叠加层样式，修改后只需重绘，不必重新处理帧
+struct OverlayStyle {
+    bool showBoxes = true;          // 边界框
+    bool showLabels = true;         // 类别和置信度
+    bool showKeypoints = true;      // 关键点及四边形
+    bool showRegions = true;        // 分块 / 跟踪裁剪区域
+    qreal lineWidth = 2.0;          // 线宽（显示像素，不随缩放变化）
+};
+
+// 检测结果的矢量叠加层：在显示分辨率下用 QPainter 绘制，原始帧不做修改
+class DetectionOverlay
+{
+public:
+    // 绘制到 painter，scale 为原图坐标到绘制目标的缩放比例
+    static void paint(QPainter& painter, const DetectionResult& overlay,
+                      qreal scale, const OverlayStyle& style);
+
+    // 在图像副本上按原分辨率绘制（用于保存当前帧）
+    static QImage render(const QImage& image, const DetectionResult& overlay,
+                         const OverlayStyle& style);
+
+    // 左上角的半透明文字面板（阶段耗时 HUD），每项一行，等宽字体
+    static void paintHud(QPainter& painter, const QStringList& lines);
+};
+
+#endif // DETECTIONOVERLAY_H
@@ -0,0 +1,49 @@
+#ifndef DETECTIONRESULT_H
+#define DETECTIONRESULT_H
+
+#include <QMetaType>
+#include <QString>
+#include <memory>
+#include <vector>
+
+#include "buffdetector.h"
+
+// 一帧的检测结果，坐标均为原图坐标
+// 通过 DetectionResultPool 循环复用，稳态下跨线程传递不再分配内存
+struct DetectionResult {
+    std::vector<rm_buff::Blade> blades;     // 检测结果
+    std::vector<cv::Rect> regions;          // 分块或跟踪裁剪区域
+    QString message;                        // 提示信息（如模型未加载）
+    bool detected = false;                  // 是否来自检测模式（其他显示模式只清空叠加层）
+
+    void clear() {
+        blades.clear();
+        regions.clear();
+        message.clear();
+        detected = false;
+    }
+    bool isEmpty() const { return blades.empty() && regions.empty() && message.isEmpty(); }
+};
+
+// 信号中传递的只读共享结果
+using DetectionResultPtr = std::shared_ptr<const DetectionResult>;
+Q_DECLARE_METATYPE(DetectionResultPtr)
+
+// 检测结果缓冲池：只有池本身引用的结果才会被复用，界面仍在使用的结果不会被覆盖
+// acquire 只能由一个线程调用（流水线运行时为推理线程）
+class DetectionResultPool
+{
+public:
+    explicit DetectionResultPool(size_t maxSize = 16, size_t reserveBlades = 64);
+
+    // 取出一个已清空的结果，所有缓冲都在使用中时新建（池已满时不再保留）
+    std::shared_ptr<DetectionResult> acquire();
+
+private:
+    std::vector<std::shared_ptr<DetectionResult>> items_;
+    size_t maxSize_;
+    size_t reserveBlades_;
+    size_t next_ = 0;
+};
+
+#endif // DETECTIONRESULT_H
@@ -0,0 +1,42 @@
+#ifndef DETECTORGROUP_H
+#define DETECTORGROUP_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "buffdetector.h"
+
+namespace rm_buff
+{
+
+// 多模型并行检测：同一帧上各模型的推理请求同时运行
+// 输入布局相同的模型只预处理一次，共享同一个输入张量
+class DetectorGroup
+{
+public:
+    // 加入检测器（不持有所有权），加入时确定输入共享关系
+    void add(Detector* detector);
+    void clear();
+
+    bool empty() const { return detectors_.empty(); }
+    size_t size() const { return detectors_.size(); }
+
+    // 所有检测器检测同一帧，返回合并后的结果，引用在下一次调用前有效
+    // 各模型的类别名互不相同，合并时不做跨模型 NMS
+    const std::vector<Blade>& Detect(const cv::Mat& src_img);
+
+    // 第 i 个检测器本帧的结果
+    const std::vector<Blade>& result(size_t i) const { return *results_[i]; }
+
+private:
+    std::vector<Detector*> detectors_;
+    std::vector<int> share_source_;                 // 共享输入的来源下标，-1 为自行预处理
+    std::vector<size_t> order_;                     // 启动顺序
+    std::vector<const std::vector<Blade>*> results_;
+    std::vector<Blade> blades_;
+    std::vector<Blade> empty_;
+};
+
+} // namespace rm_buff
+
+#endif // DETECTORGROUP_H
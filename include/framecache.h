@@ -0,0 +1,67 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "detectionresult.h"
+
+// 解码帧缓存：以帧位置（从 1 开始，与 FramePacket::index 一致）为键的 LRU 缓存，容量按字节计
+// 除原始帧外可同时保存处理后的图像和检测结果，参数版本不符时只复用原始帧
+// 播放时由显示线程写入，单步和定位时由界面线程查找，所有方法都加锁
+class FrameCache
+{
+public:
+    struct Entry {
+        cv::Mat frame;                  // 解码得到的原始帧
+        cv::Mat processed;              // 处理后的图像，可为空
+        DetectionResultPtr result;      // 与 processed 对应的检测结果
+        int paramsVersion = -1;         // 处理时的参数版本，-1 表示 processed 不可复用
+        double timestampMs = 0.0;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        int entries = 0;
+        size_t bytes = 0;
+        size_t capacity = 0;
+    };
+
+    explicit FrameCache(size_t capacityBytes = 0);
+
+    // 容量为 0 时关闭缓存；缩小容量时立即淘汰
+    void setCapacity(size_t capacityBytes);
+    size_t capacity() const;
+    bool enabled() const { return capacity() > 0; }
+
+    // 写入或更新一帧；新条目没有可复用的处理结果时保留旧条目的处理结果
+    void insert(int index, const Entry& entry);
+    // 查找并计入命中 / 未命中，命中的条目移到最近使用
+    bool lookup(int index, Entry& entry);
+    // 只判断是否存在，不计数也不改变淘汰顺序（预取用）
+    bool contains(int index) const;
+
+    void clear();
+    void resetStats();
+    Stats stats() const;
+
+private:
+    using Item = std::pair<int, Entry>;
+
+    static size_t bytesOf(const Entry& entry);
+    void evict();
+
+    mutable std::mutex mutex_;
+    std::list<Item> items_;                                     // 最近使用的在前
+    std::unordered_map<int, std::list<Item>::iterator> map_;
+    size_t capacity_;
+    size_t bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+#endif // FRAMECACHE_H
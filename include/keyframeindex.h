@@ -0,0 +1,61 @@
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace rm_buff
+{
+
+// 视频关键帧 / 时间戳索引
+// 建立时以 FFmpeg 原始码流模式读取，只解复用不解码，长视频也只需顺序读一遍文件
+// 帧号从 0 开始，与 CAP_PROP_POS_FRAMES 一致
+//
+// OpenCV 的 FFmpeg 后端不提供按关键帧定位：设置 CAP_PROP_POS_FRAMES 时先退到目标前
+// kSeekPreroll 帧之前的关键帧，再逐帧解码到目标，定位到关键帧本身也一样
+// 索引不能让单次定位变快，只用来估计这次定位要解码多少帧，从而决定重新定位还是继续向后解码
+class KeyframeIndex
+{
+public:
+    // 后端定位时在目标之前预留的帧数（OpenCV cap_ffmpeg 的初始回退量）
+    static constexpr int kSeekPreroll = 16;
+
+    // 扫描整个视频；cancel 置位时提前返回 false
+    // 所用 OpenCV 不支持原始码流读取或视频中没有关键帧标记时返回 false
+    bool build(const std::string& video_path, const std::atomic<bool>* cancel = nullptr);
+
+    // 索引文件带有调用方提供的签名（如视频大小和修改时间），签名不符时视为过期
+    bool save(const std::string& index_path, const std::string& signature) const;
+    bool load(const std::string& index_path, const std::string& signature);
+
+    // 默认的索引文件路径：与视频同目录
+    static std::string pathFor(const std::string& video_path);
+
+    void clear();
+    bool empty() const { return keyframes_.empty(); }
+    int frameCount() const { return static_cast<int>(timestamps_.size()); }
+    int keyframeCount() const { return static_cast<int>(keyframes_.size()); }
+
+    // 不晚于 frame 的最近关键帧，从这里向后解码即可得到 frame
+    int keyframeAtOrBefore(int frame) const;
+    // 离 frame 最近的关键帧，拖动进度条预览时只显示关键帧
+    int nearestKeyframe(int frame) const;
+    // frame 的显示时间戳（毫秒）
+    double timestampMs(int frame) const;
+
+    // 后端定位到 frame 需要解码的帧数（估计值，不含定位本身的开销）
+    int seekCost(int frame) const;
+    // 当前解码位置为 position（下一次读出的帧号，-1 为未知）时，到达 frame 是否应重新定位
+    // 目标在后面且向后解码的帧数不超过定位的代价时继续解码，否则重新定位
+    bool shouldSeek(int position, int frame) const;
+
+private:
+    std::vector<int> keyframes_;        // 关键帧帧号，升序
+    std::vector<double> timestamps_;    // 每帧的时间戳（毫秒）
+};
+
+} // namespace rm_buff
+
+#endif // KEYFRAMEINDEX_H
@@ -0,0 +1,81 @@
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <QString>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// 各处理阶段耗时的滚动统计
+// 每个阶段保留最近 window 个样本，样本按对数分桶计数（相邻桶上界相差 10%），分位数由直方图估算
+// 记录一次只做一次分桶和两次计数增减，可在解码 / 推理 / 显示线程和界面线程中同时调用
+class LatencyStats
+{
+public:
+    enum Stage {
+        Decode,         // 读取并解码一帧
+        Preprocess,     // letterbox + 归一化
+        Inference,      // 推理
+        Postprocess,    // 解码检测头 + NMS
+        Process,        // 推理线程处理一帧的总耗时（含运动门限、跟踪等）
+        Convert,        // cv::Mat 转 QImage
+        Scale,          // 界面线程缩放到显示尺寸
+        Draw,           // 界面线程绘制检测叠加层
+        FrameAge,       // 从解码完成到显示在界面上
+        StageCount
+    };
+
+    // 统计摘要，单位毫秒
+    struct Summary {
+        int count = 0;
+        double last = 0.0;
+        double mean = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    explicit LatencyStats(int window = 300);
+
+    void record(Stage stage, double ms);
+    void record(Stage stage, Clock::time_point start, Clock::time_point end) {
+        record(stage, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    Summary summary(Stage stage) const;
+
+    // 清空全部阶段（打开新媒体时）
+    void reset();
+
+    static const char* stageName(Stage stage);
+
+    // 当前窗口内的统计写入 CSV：每个阶段一行摘要，之后每个样本一行（按记录顺序）
+    bool writeCsv(const QString& path, QString* error = nullptr) const;
+
+private:
+    static constexpr int kBuckets = 160;        // 0.01 ms 起，覆盖到约 40 s
+
+    struct Histogram {
+        mutable std::mutex mutex;
+        std::vector<float> samples;             // 环形窗口
+        std::vector<uint8_t> bins;              // 与 samples 对应的桶号
+        std::array<int, kBuckets> counts{};
+        int next = 0;
+        int size = 0;
+        double sum = 0.0;
+    };
+
+    static int bucketOf(double ms);
+    static double bucketValue(int bucket);
+    static double percentile(const Histogram& h, double p, double max);
+
+    int window_;
+    std::array<Histogram, StageCount> stages_;
+};
+
+#endif // LATENCYSTATS_H
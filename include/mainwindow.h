@@ -5,7 +5,9 @@
 #include <QSettings>
 #include <QButtonGroup>
 #include <QActionGroup>
+#include <QPixmap>
 #include "mediaprocessor.h"
+#include "detectionoverlay.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -21,7 +23,8 @@ public:
 
 protected:
     void closeEvent(QCloseEvent *event) override;
-    void resizeEvent(QResizeEvent *event) override;
+    // 显示标签尺寸变化（窗口缩放、拖动分隔条、隐藏左侧面板）时按新尺寸重新显示
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
     // 文件操作
@@ -42,6 +45,8 @@ private slots:
     void zoomOut();
     void fitWindow();
     void actualSize();
+    void onOverlayStyleChanged();
+    void onLatencyPanelToggled(bool visible);
 
     // 主题切换
     void switchToLightTheme();
@@ -51,14 +56,21 @@ private slots:
     // 工具操作
     void loadModel();
     void showSettings();
+    void comparePrecisions();
     void showAbout();
+    void exportLatencyStats();
 
     // 信号响应
     void onFrameReady(const QImage &frame);
     void onFrameNumberChanged(int current, int total);
     void onFPSChanged(double fps);
     void onDetectionCountChanged(int count);
-    void onDetectionResults(const QList<QVariantMap> &results);
+    void onSkippedFramesChanged(int skipped, int total);
+    void onPlaybackStatsChanged(double lagMs, int dropped, int skipped);
+    void onFrameCacheStatsChanged(int hits, int misses, double usedMB);
+    void onLatencyStatsChanged();
+    void onFrameDecodedAt(qint64 steadyUs);
+    void onDetectionResults(const DetectionResultPtr &result);
     void onMediaInfoChanged(const QString &type, const QSize &size, const QString &info);
 
     // 参数调整
@@ -66,7 +78,16 @@ private slots:
     void onConfidenceChanged(int value);       // QSlider::valueChanged(int)
     void onNMSChanged(int value);              // QSlider::valueChanged(int)
     void onROISizeChanged(int value);          // QSpinBox::valueChanged(int)
+    void onTilingModeChanged(int index);       // QComboBox::currentIndexChanged(int)
+    void onArmorModeChanged(int index);        // QComboBox::currentIndexChanged(int)
+    void onTrackingToggled(bool checked);      // QCheckBox::toggled(bool)
+    void onFullDetectIntervalChanged(int value); // QSpinBox::valueChanged(int)
+    void onLatePolicyChanged(int index);       // QComboBox::currentIndexChanged(int)
+    void onFrameCacheSizeChanged(int megabytes); // QSpinBox::valueChanged(int)
+    void onMotionGateToggled(bool checked);    // QCheckBox::toggled(bool)
+    void onMotionThresholdChanged(double value); // QDoubleSpinBox::valueChanged(double)
     void onProgressSliderMoved(int value);     // QSlider::sliderMoved(int)
+    void onProgressSliderReleased();           // QSlider::sliderReleased()
 
 private:
     Ui::MainWindow *ui;
@@ -75,7 +96,14 @@ private:
     QActionGroup *themeActionGroup;
 
     double currentZoom_;
-    QImage currentDisplayImage_;
+    QImage currentDisplayImage_;           // 显示线程送来的图像，通常已缩放到显示尺寸
+    DetectionResultPtr currentOverlay_;    // 与 currentDisplayImage_ 对应的检测结果
+    QSize displayBounds_;                  // 最近一次交给 MediaProcessor 的显示区域
+    QPixmap basePixmap_;                   // 不含叠加层的显示位图，同一帧且尺寸不变时复用
+    qint64 basePixmapKey_;                 // basePixmap_ 对应图像的 cacheKey
+    OverlayStyle overlayStyle_;
+    QStringList latencyLines_;             // 阶段耗时文本，HUD 和面板共用，随 latencyStatsChanged 刷新
+    qint64 pendingDecodedAtUs_;            // 下一次 frameReady 的帧的解码时刻，0 表示未知
     QString currentTheme_;
 
     void setupUI();
@@ -2,16 +2,29 @@
 #define MEDIAPROCESSOR_H
 
 #include <QObject>
-#include <QTimer>
 #include <QImage>
 #include <opencv2/opencv.hpp>
 #include <QDebug>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include "buffdetector.h"
+#include "precisioncheck.h"
+#include "bladetracker.h"
+#include "motiongate.h"
+#include "tileddetector.h"
+#include "detectorgroup.h"
+#include "detectionresult.h"
+#include "videopipeline.h"
+#include "keyframeindex.h"
+#include "framecache.h"
+#include "latencystats.h"
 
 class MediaProcessor : public QObject
 {
     Q_OBJECT
+    friend class rm_buff::StageBench;
 
 public:
     enum MediaType {
@@ -27,6 +40,19 @@ public:
         ROIMode
     };
 
+    enum TilingMode {
+        TilingOff,          // 整帧 letterbox 到网络输入
+        TilingFull,         // 检测全部分块
+        TilingAdaptive      // 只检测有变化或上一帧有目标的分块
+    };
+
+    enum ArmorMode {
+        ArmorOff,           // 不检测装甲板
+        ArmorRed,           // 只显示红方装甲板
+        ArmorBlue,          // 只显示蓝方装甲板
+        ArmorAll            // 显示全部装甲板
+    };
+
     explicit MediaProcessor(QObject *parent = nullptr);
     ~MediaProcessor();
 
@@ -40,6 +66,21 @@ public:
     void pause();
     void stop();
     void seekToFrame(int frameNumber);
+    // 拖动进度条时的快速预览：只显示离 frameNumber 最近的关键帧，同一关键帧不重复解码，不做检测
+    // 拖动中暂停播放，松开后由 seekToFrame 精确定位并恢复
+    void previewFrame(int frameNumber);
+    bool hasKeyframeIndex() const { return keyframeIndex_ != nullptr; }
+    // 单帧步进，播放中先暂停；优先使用帧缓存，后退未命中时把前面一段一起解码进缓存
+    void stepForward();
+    void stepBackward();
+
+    // 解码帧缓存容量（MB），0 关闭
+    void setFrameCacheSize(int megabytes);
+    int getFrameCacheSize() const { return static_cast<int>(frameCache_.capacity() >> 20); }
+    FrameCache::Stats getFrameCacheStats() const { return frameCache_.stats(); }
+
+    // 各阶段耗时的滚动统计；界面线程把缩放、绘制耗时和帧龄也记录进来
+    LatencyStats& latencyStats() { return latency_; }
 
     // 模式设置
     void setDisplayMode(DisplayMode mode);
@@ -48,8 +89,53 @@ public:
     void setROISize(int width, int height);
     void setPlaybackSpeed(double speed);
 
+    // 分块检测模式（开启时优先于跟踪模式）
+    void setTilingMode(TilingMode mode);
+    TilingMode getTilingMode() const { return params_.tiling; }
+
+    // 跟踪模式：每隔 N 帧整帧检测，其余帧只在预测的扇叶区域内裁剪检测
+    void setTrackingEnabled(bool enabled);
+    bool isTrackingEnabled() const { return params_.tracking; }
+    void setFullDetectInterval(int frames);
+
+    // 处理跟不上视频时间戳时的迟到帧策略
+    void setLatePolicy(VideoPipeline::LatePolicy policy);
+    VideoPipeline::LatePolicy getLatePolicy() const { return pipeline_.latePolicy(); }
+
+    // 运动门限：画面变化低于阈值时跳过推理，复用上次的检测结果
+    void setMotionGateEnabled(bool enabled);
+    bool isMotionGateEnabled() const { return params_.motionGate; }
+    void setMotionThreshold(double threshold);
+
     // 模型设置
     bool loadDetectionModel(const QString& modelPath);
+    void setDetectorConfig(const rm_buff::DetectorConfig& config) { detectorConfig_ = config; }
+    const rm_buff::DetectorConfig& getDetectorConfig() const { return detectorConfig_; }
+    bool reloadDetectionModel();
+    bool hasDetectionModel() const { return detector_ != nullptr; }
+
+    // 装甲板模型：与能量机关模型在同一帧上同时推理，结果合并显示
+    bool loadArmorModel(const QString& modelPath);
+    bool hasArmorModel() const { return armorDetector_ != nullptr; }
+    void setArmorMode(ArmorMode mode);
+    ArmorMode getArmorMode() const { return params_.armorMode; }
+
+    // 推理精度，已加载模型时立即重新编译
+    void setInferencePrecision(rm_buff::InferencePrecision precision);
+    rm_buff::InferencePrecision getInferencePrecision() const { return detectorConfig_.precision; }
+
+    // 网络输入边长（32 的倍数），小尺寸以精度换取延迟；已加载模型时立即重新加载
+    void setInputSize(int size);
+    int getInputSize() const { return detectorConfig_.input_size; }
+
+    // 资源路径的模型提取到可写目录（文件名为 baseName），外部路径直接使用；失败时 error 为原因
+    static bool resolveModelFiles(const QString& modelPath, const QString& baseName,
+                                  QString& actualXmlPath, QString* error = nullptr);
+
+    // 在当前媒体上抽取最多 maxFrames 帧，对比两种精度的耗时和精度，返回报告文本
+    QString comparePrecisions(rm_buff::InferencePrecision reference,
+                              rm_buff::InferencePrecision candidate,
+                              int maxFrames = 50);
 
     // 获取信息
     MediaType getMediaType() const { return mediaType_; }
@@ -60,26 +146,124 @@ public:
     QString getCurrentFilePath() const { return currentFilePath_; }
 
     void processCurrentImage();
-    QImage getCurrentProcessedImage() const { return lastProcessedImage_; }
+    // 最近一帧处理结果的原分辨率图像（保存当前帧用），按需转换
+    QImage getCurrentProcessedImage() const;
+    // 最近一帧处理结果的原分辨率尺寸（ROI 模式小于媒体尺寸），界面据此计算缩放和叠加层比例
+    QSize getCurrentProcessedSize() const;
+
+    // 显示区域：显示线程把处理结果缩放到该区域内（保持宽高比）后再交给界面，空尺寸为原分辨率
+    // 界面在标签尺寸或缩放比例变化时更新，之后的帧都按新尺寸生成
+    void setDisplayBounds(const QSize& bounds);
+    // 按当前显示区域重新生成最近一帧的显示图像并发出 frameReady（播放中由下一帧更新）
+    void refreshDisplayImage();
 
 signals:
+    // 视频播放时以下信号从流水线的显示线程发出，界面须使用排队连接
     void frameReady(const QImage &frame);
     void frameNumberChanged(int current, int total);
-    void fpsChanged(double fps);
+    void fpsChanged(double fps);                // 实测的推理帧率
     void detectionCountChanged(int count);
-    void detectionResults(const QList<QVariantMap> &results);
+    // 检测结果在对应的 frameReady 之前发出
+    void detectionResults(const DetectionResultPtr &result);
     void statusMessage(const QString &message);
     void mediaInfoChanged(const QString &type, const QSize &size, const QString &info);
+    void skippedFramesChanged(int skipped, int total);
+    // 播放落后于实时的毫秒数，以及本次播放丢弃 / 跳过推理的帧数
+    void playbackStatsChanged(double lagMs, int dropped, int skipped);
+    // 帧缓存的累计命中 / 未命中次数和占用
+    void frameCacheStatsChanged(int hits, int misses, double usedMB);
+    // 阶段耗时统计有更新（播放中每半秒一次，单步和处理图片后各一次）
+    void latencyStatsChanged();
+    // 紧接着的 frameReady 所对应帧的解码完成时刻（单调时钟，微秒），未经解码的帧不发出
+    void frameDecodedAt(qint64 steadyUs);
 
 private slots:
+    // 单步：在界面线程中同步解码、处理并显示一帧（流水线停止时使用）
     void processNextFrame();
+    void onPlaybackFinished();
+    void onKeyframeIndexBuilt();
+    // 暂停时在空闲的事件循环中逐帧向后预取，每次只解码一帧
+    void prefetchNext();
 
 private:
-    cv::Mat processFrame(const cv::Mat& frame);
-    cv::Mat detectObjects(const cv::Mat& frame);
+    // 处理参数快照：界面线程修改后整体发布，处理线程在每帧开始时取用
+    struct ProcessingParams {
+        DisplayMode displayMode = OriginalMode;
+        double confidence = 0.5;
+        double nms = 0.4;
+        int roiWidth = 640;
+        int roiHeight = 480;
+        TilingMode tiling = TilingOff;
+        bool tracking = false;
+        int fullDetectInterval = 10;
+        bool motionGate = false;
+        double motionThreshold = 2.0;
+        ArmorMode armorMode = ArmorOff;
+    };
+
+    // 界面线程：发布新参数
+    void publishParams(const ProcessingParams& params);
+    // 处理线程：参数有更新时取快照并应用到检测器、跟踪器等
+    void syncParams();
+
+    // 处理一帧，结果写入 packet（处理线程或停止播放时的界面线程）
+    void processFrame(const cv::Mat& frame, FramePacket& packet);
+    // 转换并发出一帧的全部信号（显示线程或界面线程）
+    // cacheFrame 只在暂停时的单步、定位和预览中为 true；连续播放的帧不进帧缓存，缓冲留在流水线中复用
+    void presentFrame(FramePacket& packet, bool cacheFrame = false);
+
+    cv::Mat detectObjects(const cv::Mat& frame, FramePacket& packet);
     cv::Mat applyBinary(const cv::Mat& frame);
     cv::Mat extractROI(const cv::Mat& frame);
-    QImage matToQImage(const cv::Mat& mat);
+    // 包装为共享 cv::Mat 内存的只读 QImage（BGR888，Qt 5.14 以下先转为 RGB），不深拷贝
+    static QImage matToQImage(const cv::Mat& mat);
+    // 缩放到显示区域后包装，显示线程中调用
+    QImage toDisplayImage(const cv::Mat& mat);
+    void resetMotionStats();
+
+    // 视频流水线的启动和停止；停止时把解码位置退回到最后显示的帧
+    void startPipeline();
+    void stopPipeline();
+    double frameDurationMs() const;
+
+    // 关键帧索引：先尝试读取已保存的索引，没有则在后台线程建立并保存
+    void openKeyframeIndex(const QString& filePath);
+    void cancelKeyframeIndex();
+    // 定位到第 frame 帧之前（下一次读取得到第 frame 帧，帧号从 0 开始）
+    // 有索引时按估计的定位代价在重新定位和继续向后解码之间选择，否则总是交给 CAP_PROP_POS_FRAMES
+    void seekCapture(int frame);
+    // 读取一帧并记录解码耗时，decodedAt 不为空时写入读完的时刻
+    bool decodeFrame(cv::Mat& frame, std::chrono::steady_clock::time_point* decodedAt = nullptr);
+
+    // 显示第 index 帧（从 1 开始）：缓存命中时不解码，处理结果可复用时也不再推理
+    // direction < 0 时未命中会向前多解码一段放入缓存，> 0 时显示后向后预取
+    void showFrame(int index, int direction);
+    void schedulePrefetch(int lastIndex);
+
+    // 检测器的候选下限：播放时（streaming）关闭，按正常阈值解码；停止 / 暂停时开启，保留低分候选供重新筛选
+    // 只在界面线程、流水线启动前或停止后调用
+    void updateCandidateFloor(bool streaming);
+    // 阈值变化且无法只重新筛选时：当前图像重新处理，暂停的视频帧重新检测一次
+    void redetectCurrentFrame();
+    // 阈值变化时对当前图像或暂停帧的缓存候选重新筛选、NMS，不再推理
+    // 候选不属于当前显示的帧、来自分块检测或阈值低于缓存下限时返回 false
+    bool refilterDetections();
+    void emitFrameCacheStats();
+
+    // SkipInference 策略下的迟到帧：检测模式沿用上次结果，其他模式照常处理
+    void passThroughFrame(const cv::Mat& frame, FramePacket& packet);
+    // 显示线程中定期发出实测帧率和延迟
+    void emitPlaybackStats();
+
+    bool createDetector(const QString& modelPath);
+    bool createArmorDetector(const QString& modelPath);
+
+    rm_buff::DetectorConfig makeDetectorConfig(rm_buff::ModelType type) const;
+    void rebuildDetectorGroup();
+
+    // 按装甲板模式筛选并追加装甲板检测结果
+    void appendArmor(const std::vector<rm_buff::Blade>& armors, std::vector<rm_buff::Blade>& out) const;
+    void applyDetectorThresholds();
 
     // 媒体数据
     MediaType mediaType_;
@@ -88,25 +272,80 @@ private:
 
     // 检测器
     std::unique_ptr<rm_buff::Detector> detector_;
+    rm_buff::DetectorConfig detectorConfig_;    // 下次加载模型时使用
+    QString modelPath_;                         // 最近一次加载的模型路径（可为资源路径）
+    QString actualModelPath_;                   // 提取后的模型文件路径
 
-    QTimer *timer_;
     QString currentFilePath_;
     QSize mediaSize_;
-    QImage lastProcessedImage_;
-
-    // 显示参数
-    DisplayMode displayMode_;
-    double confidenceThreshold_;
-    double nmsThreshold_;
-    int roiWidth_;
-    int roiHeight_;
+    // 最近一帧的处理结果和交给界面的显示图像，显示区域由界面线程设置
+    mutable std::mutex presentMutex_;
+    cv::Mat lastProcessed_;
+    QImage lastDisplayImage_;
+    QSize displayBounds_;
+    // lastProcessed_ 与帧缓冲共用数据时，该缓冲由这里持有，上一帧的缓冲换回流水线供解码复用（只在显示阶段使用）
+    cv::Mat lastFrame_;
+
+    // 处理参数：params_ 只由界面线程修改，active_ 只由处理线程使用
+    ProcessingParams params_;
+    ProcessingParams active_;
+    std::mutex paramsMutex_;
+    std::atomic<int> paramsVersion_;
+    int activeVersion_;
     double playbackSpeed_;
 
     // 视频信息
-    int totalFrames_;
-    int currentFrame_;
+    std::atomic<int> totalFrames_;              // 建立索引后以实际帧数为准
+    std::atomic<int> currentFrame_;             // 最后显示的帧位置
+    int decodedFrame_;                          // 已读取的帧数，-1 表示位置未知（解码线程写）
     double fps_;
     bool isPlaying_;
+
+    // 解码 -> 推理 -> 显示 流水线
+    VideoPipeline pipeline_;
+    FramePacket stepPacket_;                    // 界面线程单步处理用的帧包
+    DetectionResultPool resultPool_;
+    DetectionResultPtr emptyResult_;            // 非检测模式使用的空结果
+    DetectionResultPtr lastResult_;             // 最近一次推理的结果，运动门限跳过时复用
+    std::chrono::steady_clock::time_point lastStatsEmit_;   // 显示线程上次发出统计的时刻
+
+    // 关键帧索引：keyframeIndex_ 只在界面线程使用，后台建立的结果经 pendingIndex_ 交接
+    std::unique_ptr<rm_buff::KeyframeIndex> keyframeIndex_;
+    std::unique_ptr<rm_buff::KeyframeIndex> pendingIndex_;
+    std::mutex indexMutex_;
+    std::thread indexThread_;
+    std::atomic<bool> indexCancel_;
+    int previewKeyframe_;                       // 最近一次预览的关键帧，-1 表示未在预览
+    bool resumeAfterSeek_;                      // 拖动开始时正在播放，定位后恢复
+
+    // 解码帧缓存和暂停时的预取
+    FrameCache frameCache_;
+    int prefetchUntil_;                         // 预取到的最后一帧，-1 表示不预取
+    bool prefetchQueued_;
+
+    // 各阶段耗时
+    LatencyStats latency_;
+
+    // 检测器中缓存的候选所属的帧（图像为 0），-1 表示没有可重新筛选的候选
+    int candidatesFrame_;
+    bool candidatesArmor_;                      // 该帧是否同时推理了装甲板模型
+
+    // 装甲板检测，与能量机关检测器共享同一个 ov::Core
+    std::shared_ptr<ov::Core> core_;
+    std::unique_ptr<rm_buff::Detector> armorDetector_;
+    QString armorModelPath_;
+    rm_buff::DetectorGroup group_;
+
+    // 分块检测
+    rm_buff::TiledDetector tiledDetector_;
+
+    // 跟踪
+    rm_buff::BladeTracker tracker_;
+
+    // 运动门限
+    rm_buff::MotionGate motionGate_;
+    int skippedFrames_;                         // 跳过推理的帧数
+    int gatedFrames_;                           // 经过运动判断的帧数
 };
 
 #endif // MEDIAPROCESSOR_H
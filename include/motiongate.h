@@ -0,0 +1,45 @@
+#ifndef MOTIONGATE_H
+#define MOTIONGATE_H
+
+#include <opencv2/opencv.hpp>
+
+namespace rm_buff
+{
+
+// 运动门限：在推理前用降采样灰度帧差判断画面是否变化
+// 帧差按 cell_size 大小的网格求每格平均，取最大的一格与阈值比较，
+// 静止背景上的小目标（如旋转的能量机关）不会被整幅画面平均掉
+// 参考帧只在判定为有变化时更新，缓慢的累积变化最终也会触发推理
+class MotionGate
+{
+public:
+    explicit MotionGate(double threshold = 2.0, int sample_width = 64, int cell_size = 8);
+
+    // 任一网格与参考帧的平均灰度差超过阈值时返回 true，并把当前帧设为新的参考帧
+    bool hasMotion(const cv::Mat& frame);
+
+    void reset();
+
+    // 阈值为 0~255 灰度级上单个网格的平均绝对差
+    void setThreshold(double threshold) { threshold_ = threshold; }
+    double getThreshold() const { return threshold_; }
+
+    // 最近一次计算的最大网格差值
+    double lastScore() const { return last_score_; }
+
+private:
+    double threshold_;
+    int sample_width_;
+    int cell_size_;         // 降采样图上的网格边长（像素）
+    double last_score_ = 0.0;
+
+    cv::Mat small_;         // 降采样的 BGR 图像
+    cv::Mat gray_;          // 当前帧灰度
+    cv::Mat reference_;     // 参考帧灰度
+    cv::Mat diff_;
+    cv::Mat cells_;         // 每个网格的平均差
+};
+
+} // namespace rm_buff
+
+#endif // MOTIONGATE_H
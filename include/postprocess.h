@@ -0,0 +1,158 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <cstddef>
+#include <vector>
+
+namespace rm_buff
+{
+
+// 解码后的候选目标（结构体数组布局，坐标仍为网络输入坐标）
+struct CandidateBuffer {
+    std::vector<float> cx;          // 中心 x
+    std::vector<float> cy;          // 中心 y
+    std::vector<float> w;           // 宽
+    std::vector<float> h;           // 高
+    std::vector<float> score;       // 最大类别分数
+    std::vector<int> class_id;      // 最大分数对应的类别
+    std::vector<int> batch;         // 所属图像在 batch 中的下标
+    std::vector<float> kpt;         // 每个候选 kpt_num 个 (x, y)，越界点为 (-1, -1)
+    std::vector<int> survivors;     // 扫描阶段通过阈值的 anchor 下标
+    int kpt_num = 0;
+
+    size_t size() const { return score.size(); }
+
+    void reserve(size_t n, int kpt_count);
+    void clear();
+};
+
+// NMS 选项
+struct NmsOptions {
+    float iou_thres = 0.4f;
+    bool class_agnostic = true;     // true 为跨类别抑制（与 cv::dnn::NMSBoxes 一致），false 只抑制同类
+    int max_det = 300;              // 每张图（batch 中每个下标）最多保留的目标数，各图分别计数
+};
+
+// NMS 工作区（浮点框的结构体数组及排序缓冲），可重复使用避免分配
+struct NmsWorkspace {
+    std::vector<float> x1;
+    std::vector<float> y1;
+    std::vector<float> x2;
+    std::vector<float> y2;
+    std::vector<float> area;
+    std::vector<int> order;
+    std::vector<unsigned char> suppressed;
+    std::vector<int> kept;          // 每个 batch 下标已保留的目标数
+
+    void reserve(size_t n);
+};
+
+// 只保留分数 >= conf_thres 的候选，原地压缩并保持原有顺序
+// 以较低阈值解码的候选在阈值提高后筛选，结果与直接按新阈值解码一致
+void filter_candidates(CandidateBuffer& cand, float conf_thres);
+
+// 检测头布局（通道优先输出中各项特征的起始通道）
+// 框为 cx, cy, w, h 四个通道，随后 ClsNum 个类别分数和 KptNum 个 (x, y) 关键点
+template <int ClsNum, int KptNum,
+          int BoxOffset = 0, int ClsOffset = 4, int KptOffset = ClsOffset + ClsNum>
+struct HeadLayout {
+    static constexpr int cls_num = ClsNum;
+    static constexpr int kpt_num = KptNum;
+    static constexpr int box_offset = BoxOffset;
+    static constexpr int cls_offset = ClsOffset;
+    static constexpr int kpt_offset = KptOffset;
+    static constexpr int num_features = KptOffset + 2 * KptNum;
+
+    // 加载模型时用输出的特征数校验布局
+    static bool matches(int features) { return features == num_features; }
+};
+
+// 能量机关：4 类（RR/RW/BR/BW）+ 4 个关键点，共 16 个通道
+using BuffHead = HeadLayout<4, 4>;
+
+// 装甲板：4 类颜色（BLUE/RED/GRAY/PURPLE）+ 4 个灯条角点，共 16 个通道
+// 目前与 BuffHead 布局相同，是同一个类型；模型输出改变时只需修改这里的参数
+using ArmorHead = HeadLayout<4, 4>;
+
+namespace detail
+{
+// 类别分数扫描：把 [begin, num_anchors) 中最大类别分数 >= thres 的 anchor 下标写入 out，返回个数
+// cls 指向第一个类别通道，相邻通道间隔 num_anchors
+using ScanFn = int (*)(const float* cls, int num_anchors, int cls_num,
+                       float thres, int begin, int* out);
+
+// 按 CPU 支持的指令集（AVX-512 / AVX2 / 标量）选择扫描实现，常见类别数使用展开的版本
+ScanFn select_scan(int cls_num);
+} // namespace detail
+
+// 在模型原生的通道优先布局 [bs, num_features, num_anchors] 上按编译期布局 Head 解码候选目标
+// 第一遍以 SIMD 一次扫描 8/16 个 anchor 的类别分数，只有最大分数 >= conf_thres 的 anchor 才解码写入 out
+// 类别数、关键点数和通道偏移都是常量，内层循环完全展开；定义在头文件中，任意 HeadLayout 都可直接使用
+template <typename Head>
+void decode_candidates(
+    const float* data,
+    int bs,
+    int num_anchors,
+    float conf_thres,
+    float input_size,
+    CandidateBuffer& out)
+{
+    static_assert(Head::cls_num > 0, "head must have at least one class");
+    static const detail::ScanFn scan = detail::select_scan(Head::cls_num);
+
+    out.clear();
+    out.kpt_num = Head::kpt_num;
+    out.survivors.resize(num_anchors);
+
+    for (int b = 0; b < bs; ++b) {
+        const float* base = data + size_t(b) * Head::num_features * num_anchors;
+        const float* box = base + Head::box_offset * num_anchors;
+        const float* cls = base + Head::cls_offset * num_anchors;
+        const float* kpt = base + Head::kpt_offset * num_anchors;
+
+        int count = scan(cls, num_anchors, Head::cls_num, conf_thres, 0, out.survivors.data());
+
+        for (int n = 0; n < count; ++n) {
+            const int j = out.survivors[n];
+
+            float max_score = cls[j];
+            int class_id = 0;
+            for (int k = 1; k < Head::cls_num; ++k) {
+                const float s = cls[k * num_anchors + j];
+                class_id = s > max_score ? k : class_id;
+                max_score = s > max_score ? s : max_score;
+            }
+
+            out.cx.push_back(box[0 * num_anchors + j]);
+            out.cy.push_back(box[1 * num_anchors + j]);
+            out.w.push_back(box[2 * num_anchors + j]);
+            out.h.push_back(box[3 * num_anchors + j]);
+            out.score.push_back(max_score);
+            out.class_id.push_back(class_id);
+            out.batch.push_back(b);
+
+            // 布局已在加载时用 Head::matches 校验，无需逐点检查通道下标，只检查坐标是否在输入范围内
+            for (int k = 0; k < Head::kpt_num; ++k) {
+                const float x = kpt[(2 * k) * num_anchors + j];
+                const float y = kpt[(2 * k + 1) * num_anchors + j];
+                const bool valid = x >= 0 && y >= 0 && x <= input_size && y <= input_size;
+                out.kpt.push_back(valid ? x : -1.0f);
+                out.kpt.push_back(valid ? y : -1.0f);
+            }
+        }
+    }
+}
+
+// 浮点精度的贪心 NMS，keep 输出保留的候选下标（按分数降序）
+// 不同 batch 的候选互不抑制，max_det 按 batch 分别限制，某张图保留数达到上限后只停止该图；
+// 候选数较少时按选择法逐个取最大值，无需排序，所有图都达到上限即提前退出
+void non_max_suppression(
+    const CandidateBuffer& cand,
+    const NmsOptions& opts,
+    NmsWorkspace& ws,
+    std::vector<int>& keep
+);
+
+} // namespace rm_buff
+
+#endif // POSTPROCESS_H
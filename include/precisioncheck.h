@@ -0,0 +1,52 @@
+#ifndef PRECISIONCHECK_H
+#define PRECISIONCHECK_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "buffdetector.h"
+
+namespace rm_buff
+{
+
+// 单个精度的运行统计
+struct PrecisionStats {
+    InferencePrecision precision = InferencePrecision::Default;
+    std::string device;
+    double mean_ms = 0.0;           // 单帧平均耗时（预处理 + 推理 + 后处理）
+    double max_ms = 0.0;
+    int detections = 0;             // 所有帧的检测总数
+};
+
+// 两种精度在同一组帧上的对比结果（以 reference 为基准）
+struct PrecisionReport {
+    PrecisionStats reference;
+    PrecisionStats candidate;
+    int frames = 0;
+    int matched = 0;                // 同类别且 IoU >= 0.5 的配对数
+    int missed = 0;                 // 基准检出而候选未检出
+    int extra = 0;                  // 候选多检出
+    double mean_iou = 0.0;          // 配对框的平均 IoU
+    double min_iou = 0.0;
+    double mean_kpt_error = 0.0;    // 配对关键点的平均像素误差
+    double max_kpt_error = 0.0;
+};
+
+// 精度名称，用于界面和报告
+const char* precision_name(InferencePrecision precision);
+
+// 分别以两种精度加载同一模型，在相同的帧上检测并对比耗时、框 IoU 和关键点误差
+// 两个检测器依次运行，避免互相抢占计算资源影响耗时
+PrecisionReport compare_precisions(const std::string& model_path,
+                                   const DetectorConfig& base_config,
+                                   InferencePrecision reference,
+                                   InferencePrecision candidate,
+                                   const std::vector<cv::Mat>& frames);
+
+// 生成可读的对比报告
+std::string format_precision_report(const PrecisionReport& report);
+
+} // namespace rm_buff
+
+#endif // PRECISIONCHECK_H
@@ -0,0 +1,34 @@
+#ifndef SETTINGSDIALOG_H
+#define SETTINGSDIALOG_H
+
+#include <QDialog>
+
+#include "buffdetector.h"
+
+class QComboBox;
+class QCheckBox;
+class QSpinBox;
+
+// 检测器参数设置对话框，修改的配置在下次加载模型时生效
+class SettingsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SettingsDialog(const rm_buff::DetectorConfig& config, QWidget *parent = nullptr);
+
+    // 合并对话框中的修改后的配置
+    rm_buff::DetectorConfig config() const;
+
+    // 精度下拉框的选项（顺序与 InferencePrecision 一致）
+    static void addPrecisionItems(QComboBox *comboBox);
+
+private:
+    rm_buff::DetectorConfig config_;
+    QComboBox *precisionCombo_;
+    QSpinBox *inputSizeSpin_;
+    QCheckBox *graphPreprocessCheck_;
+    QCheckBox *tryGpuCheck_;
+};
+
+#endif // SETTINGSDIALOG_H
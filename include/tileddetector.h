@@ -0,0 +1,86 @@
+#ifndef TILEDDETECTOR_H
+#define TILEDDETECTOR_H
+
+#include <opencv2/opencv.hpp>
+#include <utility>
+#include <vector>
+
+#include "buffdetector.h"
+#include "postprocess.h"
+
+namespace rm_buff
+{
+
+// 分块检测参数
+struct TileConfig {
+    int tile_size = 640;            // 分块边长，与网络输入一致时分块内不缩放
+    int overlap = 128;              // 相邻分块的重叠像素，应不小于远处目标的尺寸
+    bool include_full_frame = true; // 额外做一次整帧检测，负责跨块的大目标
+    bool adaptive = false;          // 只检测有变化或上一帧有目标的分块
+    double change_threshold = 4.0;  // 自适应模式下分块的平均灰度差阈值（0~255）
+    int refresh_interval = 15;      // 自适应模式下每隔多少帧检测全部分块
+    int max_tiles = 0;              // 每帧最多检测的分块数，0 为不限制
+};
+
+// 高分辨率分块检测：把大图切成重叠的分块分别检测，再跨块 NMS 合并
+// 检测器 batch > 1 时分块按 batch 推理，否则通过异步请求池并行推理
+class TiledDetector
+{
+public:
+    explicit TiledDetector(const TileConfig& config = TileConfig());
+
+    // 检测整幅图像，结果为原图坐标，引用在下一次调用前有效
+    const std::vector<Blade>& Detect(Detector& detector, const cv::Mat& src_img);
+
+    // 清除自适应模式的历史状态
+    void reset();
+
+    void setConfig(const TileConfig& config);
+    const TileConfig& getConfig() const { return config_; }
+
+    // 上一帧实际检测的分块
+    const std::vector<cv::Rect>& lastTiles() const { return active_tiles_; }
+
+    // 上一帧各分块推理的阶段耗时之和
+    const Detector::StageTimings& lastTimings() const { return timings_; }
+
+    // 按分块边长和重叠量切分，边缘分块向内平移以保持尺寸一致
+    static std::vector<cv::Rect> make_tiles(const cv::Size& size, int tile_size, int overlap);
+
+private:
+    // 自适应模式：挑选本帧需要检测的分块
+    void select_tiles(const cv::Mat& src_img);
+
+    // 合并所有分块的结果并做跨块 NMS
+    void merge(const Detector& detector);
+
+    TileConfig config_;
+    cv::Size frame_size_;
+    std::vector<cv::Rect> tiles_;           // 当前尺寸下的全部分块
+    std::vector<cv::Rect> active_tiles_;    // 本帧检测的分块
+    int frames_since_refresh_ = 0;
+
+    // 自适应模式的降采样灰度帧
+    cv::Mat small_;
+    cv::Mat gray_;
+    cv::Mat reference_;
+    cv::Mat diff_;
+
+    // 每帧的分块视图、偏移、各块结果和自适应模式的分块优先级，帧间复用
+    std::vector<cv::Mat> views_;
+    std::vector<cv::Point> offsets_;
+    std::vector<std::vector<Blade>> results_;
+    std::vector<std::pair<double, size_t>> tile_priority_;
+
+    // 合并缓冲
+    std::vector<Blade> raw_;                // 所有分块映射回原图后的结果
+    CandidateBuffer candidates_;
+    NmsWorkspace workspace_;
+    std::vector<int> keep_;
+    std::vector<Blade> blades_;
+    Detector::StageTimings timings_;
+};
+
+} // namespace rm_buff
+
+#endif // TILEDDETECTOR_H
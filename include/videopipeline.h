@@ -0,0 +1,121 @@
+#ifndef VIDEOPIPELINE_H
+#define VIDEOPIPELINE_H
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "detectionresult.h"
+#include "spscring.h"
+
+// 流水线中的一帧，帧缓冲在各阶段间循环复用
+struct FramePacket {
+    cv::Mat frame;                  // 解码得到的原始帧
+    cv::Mat processed;              // 处理后用于显示的图像
+    DetectionResultPtr result;      // 检测结果
+    int paramsVersion = -1;         // 处理时的参数版本，-1 表示处理结果不可复用
+    int index = 0;                  // 解码后的帧位置
+    double timestampMs = 0.0;       // 容器中的显示时间戳
+    std::chrono::steady_clock::time_point due;  // 按单调时钟计算的显示时刻
+    std::chrono::steady_clock::time_point decodedAt;    // 解码完成的时刻，未经解码（缓存命中）时为默认值
+    double lagMs = 0.0;             // 显示时落后于计划时刻的毫秒数
+    int skippedFrames = -1;         // 运动门限统计，-1 表示本帧未经过运动判断
+    int gatedFrames = 0;
+    bool endOfStream = false;       // 视频结束标记，不含图像
+    bool dropped = false;           // 迟到被丢弃，显示线程只负责归还
+};
+
+// 视频处理流水线：解码、推理、显示三个线程，由有界无锁环形队列相连
+// 帧包数量固定为 depth，显示线程用完后归还给解码线程，稳态下不再分配帧缓冲
+// 回调都在各自的工作线程中调用
+class VideoPipeline
+{
+public:
+    using DecodeFn = std::function<bool(FramePacket&)>;    // 解码一帧，返回 false 表示视频结束
+    using StageFn = std::function<void(FramePacket&)>;
+    using FinishedFn = std::function<void()>;
+
+    // 帧在推理前已经迟到（超过容差）时的处理方式
+    enum class LatePolicy {
+        Drop,           // 丢弃迟到帧，显示始终跟上实时
+        SkipInference,  // 迟到帧不推理，沿用上次结果直接显示
+        Block           // 每帧都推理和显示，播放变慢
+    };
+
+    // 运行统计
+    struct Stats {
+        double processFps = 0.0;    // 最近一秒实际推理的帧率
+        double lagMs = 0.0;         // 最近一帧显示时落后于实时的毫秒数
+        int dropped = 0;            // 本次播放丢弃的帧数
+        int skipped = 0;            // 本次播放跳过推理的帧数
+    };
+
+    explicit VideoPipeline(int depth = 4);
+    ~VideoPipeline();
+
+    VideoPipeline(const VideoPipeline&) = delete;
+    VideoPipeline& operator=(const VideoPipeline&) = delete;
+
+    // 启动三个工作线程；视频结束时在显示线程中调用 finished（之后流水线仍需 stop）
+    // skip 在 SkipInference 策略下处理迟到帧，为空时迟到帧照常推理
+    void start(DecodeFn decode, StageFn process, StageFn skip, StageFn present, FinishedFn finished);
+
+    // 停止并等待工作线程退出，未显示的帧被丢弃；不能在回调中调用
+    void stop();
+
+    bool isRunning() const { return running_; }
+
+    // 显示节奏由单调时钟和帧时间戳决定：第一帧开始计时，之后按 (时间戳差 / 倍速) 排定显示时刻
+    // 倍速 <= 0 时不控制节奏，尽快处理
+    void setPlaybackRate(double rate);
+    void setLatePolicy(LatePolicy policy) { latePolicy_ = policy; }
+    LatePolicy latePolicy() const { return latePolicy_; }
+
+    // 迟到容差（毫秒），通常取一帧的时长
+    void setLateTolerance(double ms) { lateToleranceMs_ = ms; }
+
+    Stats stats() const;
+
+private:
+    void decodeLoop();
+    void processLoop();
+    void presentLoop();
+
+    // 队列空或满时短暂让出 CPU
+    static void idle();
+
+    std::vector<std::unique_ptr<FramePacket>> packets_;
+    rm_buff::SpscRing<FramePacket*> free_;         // 显示 -> 解码
+    rm_buff::SpscRing<FramePacket*> decoded_;      // 解码 -> 推理
+    rm_buff::SpscRing<FramePacket*> processed_;    // 推理 -> 显示
+
+    DecodeFn decode_;
+    StageFn process_;
+    StageFn skip_;
+    StageFn present_;
+    FinishedFn finished_;
+
+    std::thread decodeThread_;
+    std::thread processThread_;
+    std::thread presentThread_;
+    std::atomic<bool> stopping_{false};
+    bool running_ = false;
+
+    // 节奏控制：倍速修改后在推理线程中以下一帧重新计时
+    std::atomic<double> rate_{1.0};
+    std::atomic<int> rateVersion_{0};
+    std::atomic<LatePolicy> latePolicy_{LatePolicy::Drop};
+    std::atomic<double> lateToleranceMs_{40.0};
+
+    // 统计
+    std::atomic<double> processFps_{0.0};
+    std::atomic<double> lagMs_{0.0};
+    std::atomic<int> dropped_{0};
+    std::atomic<int> skipped_{0};
+};
+
+#endif // VIDEOPIPELINE_H
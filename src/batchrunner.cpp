@@ -0,0 +1,403 @@
+#include "batchrunner.h"
+#include "mediaprocessor.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <thread>
+
+namespace
+{
+const QStringList kImageSuffixes = {"jpg", "jpeg", "png", "bmp", "tif", "tiff", "webp"};
+const QStringList kVideoSuffixes = {"mp4", "avi", "mkv", "mov", "webm", "flv", "m4v", "ts"};
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+bool BatchOptions::parse(const QCoreApplication& app, BatchOptions& options, QString& error)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QCoreApplication::translate(
+        "BatchRunner", "无界面批量检测：处理图片和视频，每帧一行 JSON 写入输出文件"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    const QCommandLineOption batchOption("batch", QCoreApplication::translate("BatchRunner", "以批量模式运行"));
+    const QCommandLineOption outOption({"o", "out"},
+        QCoreApplication::translate("BatchRunner", "结果文件（JSON Lines），- 为标准输出"), "file", options.outputPath);
+    const QCommandLineOption modelOption("model",
+        QCoreApplication::translate("BatchRunner", "能量机关模型 .xml"), "xml", options.modelPath);
+    const QCommandLineOption armorOption("armor",
+        QCoreApplication::translate("BatchRunner", "装甲板模型 .xml（可选）"), "xml");
+    const QCommandLineOption jobsOption({"j", "jobs"},
+        QCoreApplication::translate("BatchRunner", "工作线程数，0 为 CPU 核心数"), "n", "0");
+    const QCommandLineOption stepOption("step",
+        QCoreApplication::translate("BatchRunner", "视频每 N 帧处理一帧"), "n", "1");
+    const QCommandLineOption confOption("conf",
+        QCoreApplication::translate("BatchRunner", "置信度阈值"), "value", QString::number(options.confidence));
+    const QCommandLineOption nmsOption("nms",
+        QCoreApplication::translate("BatchRunner", "NMS 阈值"), "value", QString::number(options.nms));
+    const QCommandLineOption inputSizeOption("input-size",
+        QCoreApplication::translate("BatchRunner", "网络输入边长（32 的倍数）"), "pixels",
+        QString::number(options.inputSize));
+    parser.addOptions({batchOption, outOption, modelOption, armorOption, jobsOption, stepOption,
+                       confOption, nmsOption, inputSizeOption});
+    parser.addPositionalArgument("inputs",
+        QCoreApplication::translate("BatchRunner", "图片 / 视频文件或目录"), "<文件|目录...>");
+
+    parser.process(app);
+
+    options.inputs = parser.positionalArguments();
+    options.outputPath = parser.value(outOption);
+    options.modelPath = parser.value(modelOption);
+    options.armorModelPath = parser.value(armorOption);
+
+    bool ok = true;
+    auto toInt = [&](const QCommandLineOption& option) {
+        bool valid = false;
+        const int value = parser.value(option).toInt(&valid);
+        ok = ok && valid;
+        return value;
+    };
+    auto toDouble = [&](const QCommandLineOption& option) {
+        bool valid = false;
+        const double value = parser.value(option).toDouble(&valid);
+        ok = ok && valid;
+        return value;
+    };
+    options.jobs = toInt(jobsOption);
+    options.frameStep = toInt(stepOption);
+    options.confidence = toDouble(confOption);
+    options.nms = toDouble(nmsOption);
+    options.inputSize = toInt(inputSizeOption);
+
+    if (!ok || options.jobs < 0 || options.frameStep < 1 ||
+        options.inputSize < 32 || options.inputSize % 32 != 0) {
+        error = QCoreApplication::translate("BatchRunner", "参数无效");
+        return false;
+    }
+    if (options.inputs.isEmpty()) {
+        error = QCoreApplication::translate("BatchRunner", "没有指定输入文件或目录");
+        return false;
+    }
+    return true;
+}
+
+BatchRunner::BatchRunner(const BatchOptions& options)
+    : options_(options)
+    , nextFile_(0)
+    , finishedFiles_(0)
+    , failedFiles_(0)
+    , totalFrames_(0)
+    , totalDetections_(0)
+{
+}
+
+BatchRunner::~BatchRunner() = default;
+
+bool BatchRunner::isImageFile(const QString& path)
+{
+    return kImageSuffixes.contains(QFileInfo(path).suffix().toLower());
+}
+
+QStringList BatchRunner::collectFiles() const
+{
+    QStringList files;
+    QStringList filters;
+    for (const QString& suffix : kImageSuffixes + kVideoSuffixes) {
+        filters << "*." + suffix;
+    }
+
+    for (const QString& input : options_.inputs) {
+        const QFileInfo info(input);
+        if (info.isDir()) {
+            // 目录按路径排序，保证每次处理顺序一致
+            QStringList found;
+            QDirIterator it(input, filters, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                found << it.next();
+            }
+            found.sort();
+            files << found;
+        } else if (info.isFile()) {
+            files << info.filePath();
+        } else {
+            qWarning().noquote() << QCoreApplication::translate("BatchRunner", "跳过不存在的输入:") << input;
+        }
+    }
+    return files;
+}
+
+bool BatchRunner::loadDetectors(QString& error)
+{
+    // 吞吐模式：多推理流并行，请求池足够每个工作线程同时保留多帧在途
+    rm_buff::DetectorConfig config;
+    config.performance_mode = rm_buff::PerformanceMode::Throughput;
+    config.async_requests = std::max(2, jobs_ * 2);
+    config.input_size = options_.inputSize;
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/model_cache";
+    if (QDir().mkpath(cacheDir)) {
+        config.cache_dir = cacheDir.toStdString();
+    }
+    auto core = std::make_shared<ov::Core>();
+
+    try {
+        QString xmlPath;
+        if (!MediaProcessor::resolveModelFiles(options_.modelPath, "buff_model", xmlPath, &error)) {
+            return false;
+        }
+        config.model_type = rm_buff::ModelType::Buff;
+        detector_.reset(new rm_buff::Detector(xmlPath.toStdString(), config, core));
+        detector_->setConfThreshold(static_cast<float>(options_.confidence));
+        detector_->setNMSThreshold(static_cast<float>(options_.nms));
+
+        if (!options_.armorModelPath.isEmpty()) {
+            if (!MediaProcessor::resolveModelFiles(options_.armorModelPath, "armor_model", xmlPath, &error)) {
+                return false;
+            }
+            config.model_type = rm_buff::ModelType::Armor;
+            armorDetector_.reset(new rm_buff::Detector(xmlPath.toStdString(), config, core));
+            armorDetector_->setConfThreshold(static_cast<float>(options_.confidence));
+            armorDetector_->setNMSThreshold(static_cast<float>(options_.nms));
+        }
+    } catch (const std::exception& e) {
+        error = QString::fromLocal8Bit(e.what());
+        return false;
+    }
+
+    inflight_ = std::max(1, detector_->poolSize() / jobs_);
+    return true;
+}
+
+int BatchRunner::run()
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    files_ = collectFiles();
+    if (files_.isEmpty()) {
+        qCritical().noquote() << QCoreApplication::translate("BatchRunner", "没有可处理的图片或视频");
+        return 2;
+    }
+
+    const int cores = std::max(1, QThread::idealThreadCount());
+    jobs_ = std::min(options_.jobs > 0 ? options_.jobs : cores, files_.size());
+
+    QString error;
+    if (!loadDetectors(error)) {
+        qCritical().noquote() << QCoreApplication::translate("BatchRunner", "模型加载失败:") << error;
+        return 2;
+    }
+
+    bool opened = false;
+    if (options_.outputPath == "-") {
+        opened = output_.open(stdout, QIODevice::WriteOnly);
+    } else {
+        output_.setFileName(options_.outputPath);
+        opened = output_.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if (!opened) {
+        qCritical().noquote() << QCoreApplication::translate("BatchRunner", "无法写入结果文件:")
+                              << options_.outputPath;
+        return 2;
+    }
+
+    qInfo().noquote() << QCoreApplication::translate("BatchRunner", "批量处理 %1 个文件，%2 个工作线程，设备 %3，每线程在途 %4 帧")
+                             .arg(files_.size()).arg(jobs_)
+                             .arg(QString::fromStdString(detector_->getDevice())).arg(inflight_);
+
+    std::vector<std::thread> workers;
+    workers.reserve(static_cast<size_t>(jobs_));
+    for (int i = 0; i < jobs_; ++i) {
+        workers.emplace_back(&BatchRunner::worker, this);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    output_.close();
+
+    const double seconds = secondsSince(start);
+    const int64_t frames = totalFrames_.load();
+    qInfo().noquote() << QCoreApplication::translate("BatchRunner", "完成: %1 个文件（失败 %2），%3 帧，%4 个目标")
+                             .arg(files_.size()).arg(failedFiles_.load())
+                             .arg(frames).arg(totalDetections_.load());
+    qInfo().noquote() << QCoreApplication::translate("BatchRunner", "耗时 %1 s，吞吐 %2 帧/s")
+                             .arg(seconds, 0, 'f', 1)
+                             .arg(seconds > 0 ? frames / seconds : 0.0, 0, 'f', 1);
+
+    return failedFiles_.load() > 0 ? 1 : 0;
+}
+
+void BatchRunner::worker()
+{
+    for (;;) {
+        const int index = nextFile_++;
+        if (index >= files_.size()) {
+            return;
+        }
+        const QString& path = files_[index];
+        const auto start = std::chrono::steady_clock::now();
+        const FileStats stats = isImageFile(path) ? processImage(path) : processVideo(path);
+        reportFile(path, stats, secondsSince(start));
+    }
+}
+
+BatchRunner::FileStats BatchRunner::processImage(const QString& path)
+{
+    FileStats stats;
+    const cv::Mat image = cv::imread(path.toStdString());
+    if (image.empty()) {
+        stats.error = QCoreApplication::translate("BatchRunner", "无法读取图片");
+        return stats;
+    }
+
+    try {
+        std::vector<rm_buff::Blade> blades;
+        detector_->Detect(image, blades);
+        if (armorDetector_) {
+            std::vector<rm_buff::Blade> armors;
+            armorDetector_->Detect(image, armors);
+            blades.insert(blades.end(), armors.begin(), armors.end());
+        }
+        writeFrame(path, 0, 0.0, blades);
+        stats.frames = 1;
+        stats.detections = static_cast<int64_t>(blades.size());
+        stats.ok = true;
+    } catch (const std::exception& e) {
+        stats.error = QString::fromLocal8Bit(e.what());
+    }
+    return stats;
+}
+
+BatchRunner::FileStats BatchRunner::processVideo(const QString& path)
+{
+    FileStats stats;
+    cv::VideoCapture capture(path.toStdString());
+    if (!capture.isOpened()) {
+        stats.error = QCoreApplication::translate("BatchRunner", "无法打开视频");
+        return stats;
+    }
+
+    // 在途帧按提交顺序取回，输出保持帧序
+    struct Pending {
+        int frame;
+        double timestampMs;
+        std::future<std::vector<rm_buff::Blade>> blades;
+        std::future<std::vector<rm_buff::Blade>> armors;
+    };
+    std::deque<Pending> pending;
+
+    auto finishOne = [&]() {
+        Pending& front = pending.front();
+        std::vector<rm_buff::Blade> blades = front.blades.get();
+        if (front.armors.valid()) {
+            const std::vector<rm_buff::Blade> armors = front.armors.get();
+            blades.insert(blades.end(), armors.begin(), armors.end());
+        }
+        writeFrame(path, front.frame, front.timestampMs, blades);
+        ++stats.frames;
+        stats.detections += static_cast<int64_t>(blades.size());
+        pending.pop_front();
+    };
+
+    try {
+        // 异步提交在返回前已完成预处理（图内预处理时拷贝原图），帧缓冲可直接复用
+        cv::Mat frame;
+        for (int index = 0;; ++index) {
+            if (index % options_.frameStep != 0) {
+                if (!capture.grab()) break;
+                continue;
+            }
+            if (!capture.read(frame) || frame.empty()) {
+                break;
+            }
+
+            Pending next;
+            next.frame = index;
+            next.timestampMs = capture.get(cv::CAP_PROP_POS_MSEC);
+            next.blades = detector_->DetectAsync(frame);
+            if (armorDetector_) {
+                next.armors = armorDetector_->DetectAsync(frame);
+            }
+            pending.push_back(std::move(next));
+
+            if (static_cast<int>(pending.size()) >= inflight_) {
+                finishOne();
+            }
+        }
+        while (!pending.empty()) {
+            finishOne();
+        }
+        stats.ok = true;
+    } catch (const std::exception& e) {
+        // 等待剩余的在途请求结束再返回，推理槽才会归还到池中
+        for (Pending& rest : pending) {
+            if (rest.blades.valid()) rest.blades.wait();
+            if (rest.armors.valid()) rest.armors.wait();
+        }
+        stats.error = QString::fromLocal8Bit(e.what());
+    }
+    return stats;
+}
+
+void BatchRunner::writeFrame(const QString& path, int frame, double timestampMs,
+                             const std::vector<rm_buff::Blade>& blades)
+{
+    QJsonArray detections;
+    for (const rm_buff::Blade& blade : blades) {
+        QJsonArray keypoints;
+        for (const cv::Point2f& point : blade.kpt) {
+            keypoints.append(point.x);
+            keypoints.append(point.y);
+        }
+        QJsonObject detection;
+        detection["class"] = QLatin1String(rm_buff::class_name(blade.cls));
+        detection["score"] = blade.prob;
+        detection["box"] = QJsonArray{blade.rect.x, blade.rect.y, blade.rect.width, blade.rect.height};
+        detection["kpt"] = keypoints;
+        detections.append(detection);
+    }
+
+    QJsonObject record;
+    record["file"] = path;
+    record["frame"] = frame;
+    record["time_ms"] = timestampMs;
+    record["detections"] = detections;
+    QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    line.append('\n');
+
+    std::lock_guard<std::mutex> lock(outputMutex_);
+    output_.write(line);
+}
+
+void BatchRunner::reportFile(const QString& path, const FileStats& stats, double seconds)
+{
+    const int finished = ++finishedFiles_;
+    totalFrames_ += stats.frames;
+    totalDetections_ += stats.detections;
+
+    const QString name = QFileInfo(path).fileName();
+    if (!stats.ok) {
+        ++failedFiles_;
+        qWarning().noquote() << QString("[%1/%2] %3:").arg(finished).arg(files_.size()).arg(name)
+                             << QCoreApplication::translate("BatchRunner", "失败") << stats.error;
+        return;
+    }
+    qInfo().noquote() << QString("[%1/%2] %3: ").arg(finished).arg(files_.size()).arg(name)
+                      + QCoreApplication::translate("BatchRunner", "%1 帧，%2 帧/s")
+                            .arg(stats.frames)
+                            .arg(seconds > 0 ? stats.frames / seconds : 0.0, 0, 'f', 1);
+}
@@ -0,0 +1,85 @@
+#include "bladetracker.h"
+#include <algorithm>
+
+namespace rm_buff
+{
+
+BladeTracker::BladeTracker(const TrackerConfig& config)
+    : config_(config)
+{
+}
+
+void BladeTracker::reset()
+{
+    tracking_ = false;
+    frames_since_full_ = 0;
+    bounds_ = cv::Rect2f();
+    velocity_ = cv::Point2f();
+}
+
+bool BladeTracker::needFullDetect() const
+{
+    return !tracking_ || frames_since_full_ >= config_.full_detect_interval;
+}
+
+cv::Rect BladeTracker::predictRoi(const cv::Size& frame_size) const
+{
+    const cv::Rect frame_rect(0, 0, frame_size.width, frame_size.height);
+    if (!tracking_) {
+        return frame_rect;
+    }
+
+    // 按匀速外推中心，四周外扩，不足最小边长时补足
+    const cv::Point2f center(bounds_.x + bounds_.width * 0.5f + velocity_.x,
+                             bounds_.y + bounds_.height * 0.5f + velocity_.y);
+    float width = bounds_.width * (1.0f + 2.0f * config_.crop_margin);
+    float height = bounds_.height * (1.0f + 2.0f * config_.crop_margin);
+    width = std::max(width, static_cast<float>(config_.min_crop_size));
+    height = std::max(height, static_cast<float>(config_.min_crop_size));
+
+    // 尽量平移回图像内部而不是直接截断，保持裁剪区域尺寸
+    width = std::min(width, static_cast<float>(frame_size.width));
+    height = std::min(height, static_cast<float>(frame_size.height));
+    float x = std::min(std::max(center.x - width * 0.5f, 0.0f), frame_size.width - width);
+    float y = std::min(std::max(center.y - height * 0.5f, 0.0f), frame_size.height - height);
+
+    return cv::Rect(cvRound(x), cvRound(y), cvRound(width), cvRound(height)) & frame_rect;
+}
+
+void BladeTracker::update(const std::vector<Blade>& blades, const cv::Rect& roi, bool full_frame)
+{
+    if (blades.empty()) {
+        // 未检出目标视为丢失，下一帧整帧检测
+        tracking_ = false;
+        return;
+    }
+
+    cv::Rect bounds = blades.front().rect;
+    for (const Blade& blade : blades) {
+        bounds |= blade.rect;
+    }
+
+    // 目标贴近裁剪边界说明可能有部分在区域外，下一帧整帧检测
+    if (!full_frame) {
+        const int border = 2;
+        const cv::Rect inner(roi.x + border, roi.y + border,
+                             roi.width - 2 * border, roi.height - 2 * border);
+        if ((bounds & inner) != bounds) {
+            tracking_ = false;
+            return;
+        }
+    }
+
+    const cv::Rect2f new_bounds(bounds);
+    if (tracking_) {
+        velocity_ = cv::Point2f(new_bounds.x + new_bounds.width * 0.5f - bounds_.x - bounds_.width * 0.5f,
+                                new_bounds.y + new_bounds.height * 0.5f - bounds_.y - bounds_.height * 0.5f);
+    } else {
+        velocity_ = cv::Point2f();
+    }
+    bounds_ = new_bounds;
+    tracking_ = true;
+    frames_since_full_ = full_frame ? 0 : frames_since_full_ + 1;
+}
+
+} // namespace rm_buff
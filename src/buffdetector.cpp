@@ -1,211 +1,1115 @@
 #include "buffdetector.h"
+#include <openvino/opsets/opset8.hpp>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 namespace rm_buff
 {
 
-Detector::Detector(const std::string& model_path)
-    : model_path_(model_path)
+namespace
 {
-    core_ = ov::Core();
-    model_ = core_.read_model(model_path_);
 
-    ov::preprocess::PrePostProcessor ppp(model_);
+namespace opset = ov::opset8;
 
-    // 输入布局转换
-    ppp.input().preprocess().convert_layout({0, 3, 1, 2}); // NHWC -> NCHW
+using Clock = std::chrono::steady_clock;
 
-    // 输出布局转换
-    ppp.output().postprocess().convert_layout({0, 2, 1}); // [1,16,8400] -> [1,8400,16]
+double elapsed_ms(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+// 64 位 FNV-1a 哈希，用于生成编译缓存的键
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * kFnvPrime;
+    }
+    return hash;
+}
+
+bool fnv1a_file(const std::string& path, uint64_t& hash)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    char buffer[1 << 16];
+    while (in) {
+        in.read(buffer, sizeof(buffer));
+        hash = fnv1a(buffer, static_cast<size_t>(in.gcount()), hash);
+    }
+    return true;
+}
+
+// 在图中构建 letterbox：等比缩放到 size 以内，再用 114 居中填充到 size x size
+// 输入为 [1, H, W, 3] 的 f32 图像，H/W 可为任意值
+ov::Output<ov::Node> build_letterbox(const ov::Output<ov::Node>& image, int size)
+{
+    auto shape = std::make_shared<opset::ShapeOf>(image, ov::element::i64);
+    auto hw = std::make_shared<opset::Gather>(
+        shape,
+        opset::Constant::create(ov::element::i64, {2}, {1, 2}),
+        opset::Constant::create(ov::element::i64, {}, {0}));
+    auto hw_f = std::make_shared<opset::Convert>(hw, ov::element::f32);
+
+    // r = min(size / H, size / W)
+    auto target_f = opset::Constant::create(ov::element::f32, {2},
+                                            {float(size), float(size)});
+    auto ratio = std::make_shared<opset::ReduceMin>(
+        std::make_shared<opset::Divide>(target_f, hw_f),
+        opset::Constant::create(ov::element::i64, {1}, {0}),
+        true);
+
+    // 缩放后的尺寸，与 Detector::letterbox 一样四舍五入
+    auto inside = std::make_shared<opset::Convert>(
+        std::make_shared<opset::Round>(
+            std::make_shared<opset::Multiply>(hw_f, ratio),
+            opset::Round::RoundMode::HALF_AWAY_FROM_ZERO),
+        ov::element::i64);
+
+    opset::Interpolate::InterpolateAttrs attrs;
+    attrs.mode = opset::Interpolate::InterpolateMode::LINEAR;
+    attrs.shape_calculation_mode = opset::Interpolate::ShapeCalcMode::SIZES;
+    attrs.coordinate_transformation_mode =
+        opset::Interpolate::CoordinateTransformMode::HALF_PIXEL;
+    auto resized = std::make_shared<opset::Interpolate>(
+        image,
+        inside,
+        opset::Constant::create(ov::element::f32, {2}, {1.0f, 1.0f}),
+        opset::Constant::create(ov::element::i64, {2}, {1, 2}),
+        attrs);
+
+    // 填充：上/左取 floor(pad / 2)，下/右取剩余部分
+    auto pad_total = std::make_shared<opset::Subtract>(
+        opset::Constant::create(ov::element::i64, {2}, {size, size}), inside);
+    auto pad_begin = std::make_shared<opset::Divide>(
+        pad_total, opset::Constant::create(ov::element::i64, {}, {2}));
+    auto pad_end = std::make_shared<opset::Subtract>(pad_total, pad_begin);
+    auto zero = opset::Constant::create(ov::element::i64, {1}, {0});
+    auto padded = std::make_shared<opset::Pad>(
+        resized,
+        std::make_shared<opset::Concat>(ov::OutputVector{zero, pad_begin, zero}, 0),
+        std::make_shared<opset::Concat>(ov::OutputVector{zero, pad_end, zero}, 0),
+        opset::Constant::create(ov::element::f32, {}, {114.0f}),
+        ov::op::PadMode::CONSTANT);
+
+    // 输出尺寸固定，reshape 为静态形状以便与模型输入对齐
+    auto reshaped = std::make_shared<opset::Reshape>(
+        padded,
+        opset::Constant::create(ov::element::i64, {4}, {-1, size, size, 3}),
+        false);
+
+    return reshaped->output(0);
+}
+
+} // namespace
+
+Detector::Detector(const std::string& model_path, const DetectorConfig& config,
+                   std::shared_ptr<ov::Core> core)
+    : model_path_(modelPathFor(model_path, config.precision))
+    , config_(config)
+    , core_(core ? std::move(core) : std::make_shared<ov::Core>())
+    , input_size_(config.input_size)
+{
+    if (input_size_ < 32 || input_size_ % 32 != 0) {
+        throw std::invalid_argument("Input size must be a positive multiple of 32");
+    }
+    if (!std::ifstream(model_path_)) {
+        throw std::runtime_error("Model file not found: " + model_path_);
+    }
+
+    // 候选设备：GPU 优先，无 GPU 的机器可关闭探测直接使用 CPU
+    std::vector<std::string> devices;
+    if (config_.try_gpu) {
+        devices.push_back("GPU");
+    }
+    devices.push_back("CPU");
+
+    // 优先从缓存导入已编译模型，跳过读取、预处理构建和编译
+    const ov::AnyMap properties = compile_properties();
+    const std::string key = config_.cache_dir.empty() ? std::string() : cache_key();
+    bool loaded = false;
+    if (!key.empty()) {
+        for (const auto& device : devices) {
+            if (import_cached(key, device, properties)) {
+                loaded = true;
+                break;
+            }
+        }
+    }
+
+    if (!loaded) {
+        model_ = build_model();
+
+        // 编译模型 - 默认使用GPU，失败则使用CPU
+        for (size_t i = 0; i < devices.size(); ++i) {
+            try {
+                compiled_model_ = core_->compile_model(model_, devices[i], properties);
+                device_ = devices[i];
+                break;
+            } catch (...) {
+                if (i + 1 == devices.size()) throw;
+            }
+        }
+        std::cout << "Model compiled on " << device_ << std::endl;
+
+        if (!key.empty()) {
+            export_cached(key);
+        }
+    }
+
+    // 按模型类型选择检测头布局，并与实际输出的特征数核对
+    bool (*head_matches)(int) = nullptr;
+    int head_features = 0;
+    switch (config_.model_type) {
+    case ModelType::Buff:
+        decode_fn_ = decode_candidates<BuffHead>;
+        head_matches = BuffHead::matches;
+        head_features = BuffHead::num_features;
+        class_base_ = static_cast<int>(BladeClass::RR);
+        break;
+    case ModelType::Armor:
+        decode_fn_ = decode_candidates<ArmorHead>;
+        head_matches = ArmorHead::matches;
+        head_features = ArmorHead::num_features;
+        class_base_ = static_cast<int>(BladeClass::Blue);
+        break;
+    }
+    const ov::PartialShape output_shape = compiled_model_.output().get_partial_shape();
+    if (output_shape.size() != 3 || !output_shape[1].is_static() ||
+        !head_matches(static_cast<int>(output_shape[1].get_length())) ||
+        !output_shape[2].is_static()) {
+        throw std::runtime_error("Model output does not match the head layout: expected " +
+                                 std::to_string(head_features) + " features per anchor");
+    }
+
+    // anchor 数在加载时记下，后处理不再每帧查询输出形状（get_shape 会申请内存）
+    num_anchors_ = static_cast<int>(output_shape[2].get_length());
+
+    // 所有缓冲区在加载时一次性分配，稳态下 Detect 不再申请堆内存
+    init_slot(sync_slot_);
+    blade_array_.reserve(sync_slot_.scratch.keep.capacity());
+    const size_t batch = static_cast<size_t>(std::max(1, config_.batch_size));
+    batch_srcs_.reserve(batch);
+    batch_index_.reserve(batch);
+    batch_outs_.resize(batch);
+
+    // 创建推理请求池，异步推理完成后在回调线程中完成后处理
+    // 吞吐模式下至少创建设备建议数量的请求，才能让所有推理流同时工作
+    int num_slots = std::max(1, config_.async_requests);
+    if (config_.performance_mode == PerformanceMode::Throughput) {
+        const int optimal = static_cast<int>(
+            compiled_model_.get_property(ov::optimal_number_of_infer_requests));
+        num_slots = std::max(num_slots, optimal);
+    }
+    for (int i = 0; i < num_slots; ++i) {
+        std::unique_ptr<InferSlot> slot(new InferSlot);
+        init_slot(*slot);
+        InferSlot* slot_ptr = slot.get();
+        slot->request.set_callback([this, slot_ptr](std::exception_ptr error) {
+            onSlotFinished(*slot_ptr, error);
+        });
+        slots_.emplace_back(std::move(slot));
+    }
+}
+
+Detector::~Detector()
+{
+    WaitAll();
+}
+
+std::shared_ptr<ov::Model> Detector::build_model()
+{
+    std::shared_ptr<ov::Model> model = core_->read_model(model_path_);
+
+    // 按配置设置 batch 维度：固定 batch 或动态 batch
+    const ov::Dimension batch_dim = config_.batch_size > 0
+        ? ov::Dimension(config_.batch_size)
+        : ov::Dimension::dynamic();
+    // 输入为 NCHW，按配置的输入边长 reshape，输出的 anchor 数随之变化
+    ov::PartialShape input_shape = model->input().get_partial_shape();
+    const bool same_size = input_shape[2].is_static() && input_shape[3].is_static() &&
+                           input_shape[2].get_length() == input_size_ &&
+                           input_shape[3].get_length() == input_size_;
+    if (config_.batch_size != 1 || !same_size) {
+        input_shape[0] = batch_dim;
+        input_shape[2] = input_size_;
+        input_shape[3] = input_size_;
+        model->reshape(input_shape);
+    }
+
+    ov::preprocess::PrePostProcessor ppp(model);
+
+    if (config_.graph_preprocess) {
+        // 输入为任意尺寸的 u8 BGR 图像，letterbox、归一化和布局转换都在图中完成
+        const int size = input_size_;
+        ppp.input().tensor()
+            .set_element_type(ov::element::u8)
+            .set_shape(ov::PartialShape{batch_dim, -1, -1, 3});
+        ppp.input().preprocess()
+            .convert_element_type(ov::element::f32)
+            .custom([size](const ov::Output<ov::Node>& node) {
+                return build_letterbox(node, size);
+            })
+            .scale(255.0f)
+            .convert_layout({0, 3, 1, 2}); // NHWC -> NCHW
+    } else {
+        // 输入布局转换
+        ppp.input().preprocess().convert_layout({0, 3, 1, 2}); // NHWC -> NCHW
+    }
+
+    // 输出保持原生的 [1,16,8400] 通道优先布局，由 decode_candidates 直接读取
 
-    model_ = ppp.build();
+    return ppp.build();
+}
+
+std::string Detector::cache_key() const
+{
+    // 模型文件内容 + 影响编译结果的配置 + OpenVINO 版本，任一变化都会得到新的键
+    uint64_t hash = kFnvOffset;
+    std::string bin_path = model_path_;
+    const size_t dot = bin_path.rfind('.');
+    bin_path = (dot == std::string::npos ? bin_path : bin_path.substr(0, dot)) + ".bin";
+    if (!fnv1a_file(model_path_, hash) || !fnv1a_file(bin_path, hash)) {
+        return std::string();
+    }
+
+    char config_str[128];
+    std::snprintf(config_str, sizeof(config_str), "gp=%d;bs=%d;pm=%d;ns=%d;pr=%d;sz=%d",
+                  config_.graph_preprocess ? 1 : 0, config_.batch_size,
+                  static_cast<int>(config_.performance_mode), config_.num_streams,
+                  static_cast<int>(config_.precision), input_size_);
+    hash = fnv1a(config_str, std::strlen(config_str), hash);
+    const char* version = ov::get_openvino_version().buildNumber;
+    hash = fnv1a(version, std::strlen(version), hash);
+
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+    return key;
+}
+
+std::string Detector::cache_path(const std::string& key, const std::string& device) const
+{
+    return config_.cache_dir + "/" + key + "_" + device + ".blob";
+}
+
+bool Detector::import_cached(const std::string& key, const std::string& device,
+                             const ov::AnyMap& properties)
+{
+    std::ifstream in(cache_path(key, device), std::ios::binary);
+    if (!in) {
+        return false;
+    }
 
-    // 编译模型 - 默认使用GPU，失败则使用CPU
     try {
-        compiled_model_ = core_.compile_model(model_, "GPU");
-        std::cout << "Model compiled on GPU" << std::endl;
-    } catch (...) {
-        compiled_model_ = core_.compile_model(model_, "CPU");
-        std::cout << "Model compiled on CPU" << std::endl;
+        compiled_model_ = core_->import_model(in, device, properties);
+    } catch (const std::exception& e) {
+        // 设备不可用或缓存损坏时回退到完整编译
+        std::cerr << "Failed to import cached model for " << device << ": "
+                  << e.what() << std::endl;
+        return false;
     }
 
-    infer_request_ = compiled_model_.create_infer_request();
-    input_tensor_ = infer_request_.get_input_tensor(0);
+    device_ = device;
+    std::cout << "Model imported from cache on " << device_ << std::endl;
+    return true;
 }
 
-std::vector<Blade> Detector::Detect(cv::Mat& src_img)
+void Detector::export_cached(const std::string& key) const
+{
+    // 先写临时文件再改名，避免中途退出留下不完整的缓存
+    const std::string path = cache_path(key, device_);
+    const std::string tmp_path = path + ".tmp";
+    try {
+        {
+            std::ofstream out(tmp_path, std::ios::binary);
+            if (!out) {
+                std::cerr << "Cannot write model cache: " << tmp_path << std::endl;
+                return;
+            }
+            compiled_model_.export_model(out);
+            if (!out) {
+                throw std::runtime_error("write failed");
+            }
+        }
+        std::remove(path.c_str());
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("rename failed");
+        }
+    } catch (const std::exception& e) {
+        std::remove(tmp_path.c_str());
+        std::cerr << "Failed to export model cache: " << e.what() << std::endl;
+    }
+}
+
+std::string Detector::modelPathFor(const std::string& model_path, InferencePrecision precision)
+{
+    if (precision != InferencePrecision::INT8) {
+        return model_path;
+    }
+    const size_t dot = model_path.rfind('.');
+    if (dot == std::string::npos) {
+        return model_path + "_int8";
+    }
+    return model_path.substr(0, dot) + "_int8" + model_path.substr(dot);
+}
+
+ov::AnyMap Detector::compile_properties() const
+{
+    ov::AnyMap properties;
+
+    // 推理精度提示；INT8 模型已量化，其余层保持设备默认精度
+    switch (config_.precision) {
+    case InferencePrecision::FP32:
+        properties.insert(ov::hint::inference_precision(ov::element::f32));
+        break;
+    case InferencePrecision::BF16:
+        properties.insert(ov::hint::inference_precision(ov::element::bf16));
+        break;
+    case InferencePrecision::FP16:
+        properties.insert(ov::hint::inference_precision(ov::element::f16));
+        break;
+    case InferencePrecision::Default:
+    case InferencePrecision::INT8:
+        break;
+    }
+
+    if (config_.performance_mode == PerformanceMode::Throughput) {
+        properties.insert(ov::hint::performance_mode(ov::hint::PerformanceMode::THROUGHPUT));
+        if (config_.num_streams > 0) {
+            properties.insert(ov::streams::num(ov::streams::Num(config_.num_streams)));
+        }
+    } else {
+        properties.insert(ov::hint::performance_mode(ov::hint::PerformanceMode::LATENCY));
+    }
+    return properties;
+}
+
+void Detector::init_slot(InferSlot& slot)
+{
+    slot.request = compiled_model_.create_infer_request();
+
+    // 固定 batch 时按 batch 大小分配，动态 batch 先按 1 分配，之后按需增长
+    const int batch = std::max(1, config_.batch_size);
+    if (!config_.graph_preprocess) {
+        slot.own_input = slot.request.get_input_tensor(0);
+        bind_input_views(slot, batch);
+    }
+
+    // 后处理缓冲按 anchor 总数预留
+    slot.scratch.reserve(batch * size_t(num_anchors_));
+    slot.lb.resize(batch);
+}
+
+void Detector::bind_input_views(InferSlot& slot, int n)
+{
+    ov::Tensor input_tensor = slot.request.get_input_tensor(0);
+
+    // 固定 batch 时输入形状不变，只有动态 batch 才查询并调整形状
+    int batch = config_.batch_size;
+    if (config_.batch_size <= 0) {
+        if (input_tensor.get_shape()[0] != size_t(n)) {
+            input_tensor.set_shape({size_t(n), size_t(input_size_), size_t(input_size_), 3});
+        }
+        batch = n;
+    }
+    float* base = input_tensor.data<float>();
+    if (int(slot.input.size()) == batch && slot.input[0].ptr<float>() == base) {
+        return;
+    }
+
+    // letterbox 画布和直接指向请求输入张量中各图像的 float 视图
+    const size_t image_elems = size_t(input_size_) * input_size_ * 3;
+    slot.input.resize(batch);
+    for (int b = 0; b < batch; ++b) {
+        slot.input[b] = cv::Mat(input_size_, input_size_, CV_32FC3,
+                                base + b * image_elems);
+    }
+    while (int(slot.canvas.size()) < batch) {
+        slot.canvas.emplace_back(input_size_, input_size_, CV_8UC3,
+                                 cv::Scalar(114, 114, 114));
+        slot.canvas_lb.emplace_back();
+    }
+}
+
+const std::vector<Blade>& Detector::Detect(const cv::Mat& src_img)
 {
     if (src_img.empty()) {
         std::cerr << "Empty image!" << std::endl;
-        return {};
+        blade_array_.clear();
+        return blade_array_;
     }
 
-    cv::Mat img;
-    img = letterbox(src_img, buff_image_size, buff_image_size);
+    const cv::Mat* src = &src_img;
+    if (candidate_floor_ > 0.0f) {
+        infer_sync(src);
+        return detect_cached(cv::Point());
+    }
+    run_batch(sync_slot_, &src, 1, &blade_array_);
 
-    // 归一化到[0,1]
-    img.convertTo(img, CV_32FC3, 1.0 / 255.0);
+    return blade_array_;
+}
 
-    if (img.isContinuous()) {
-        img = img.reshape(1, 1);
-    } else {
-        img = img.clone().reshape(1, 1);
+const std::vector<Blade>& Detector::Detect(const cv::Mat& src_img, const cv::Rect& roi)
+{
+    const cv::Rect clipped = roi & cv::Rect(0, 0, src_img.cols, src_img.rows);
+    if (clipped.empty()) {
+        blade_array_.clear();
+        return blade_array_;
     }
 
-    input_tensor_ = ov::Tensor(
-        input_tensor_.get_element_type(),
-        input_tensor_.get_shape(),
-        img.ptr<float>()
-    );
+    const cv::Mat crop = src_img(clipped);
+    const cv::Mat* src = &crop;
+    if (candidate_floor_ > 0.0f) {
+        infer_sync(src);
+        return detect_cached(clipped.tl());
+    }
+    run_batch(sync_slot_, &src, 1, &blade_array_);
 
-    infer_request_.set_input_tensor(0, input_tensor_);
+    // 裁剪区域坐标平移回原图，无效关键点保持 (-1, -1)
+    const cv::Point2f offset(static_cast<float>(clipped.x), static_cast<float>(clipped.y));
+    for (Blade& blade : blade_array_) {
+        blade.rect.x += clipped.x;
+        blade.rect.y += clipped.y;
+        for (cv::Point2f& point : blade.kpt) {
+            if (point.x >= 0 && point.y >= 0) {
+                point += offset;
+            }
+        }
+    }
+
+    return blade_array_;
+}
+
+std::vector<std::vector<Blade>> Detector::Detect(const std::vector<cv::Mat>& src_imgs)
+{
+    std::vector<std::vector<Blade>> results;
+    Detect(src_imgs, results);
+    return results;
+}
+
+void Detector::Detect(const std::vector<cv::Mat>& src_imgs, std::vector<std::vector<Blade>>& results)
+{
+    results.resize(src_imgs.size());
+
+    // 每块最多为模型的 batch 大小；动态 batch 时整批一次推理（缓冲随批大小增长一次）
+    const size_t max_chunk = config_.batch_size > 0 ? size_t(config_.batch_size)
+                                                    : std::max<size_t>(1, src_imgs.size());
+    if (batch_outs_.size() < max_chunk) {
+        batch_outs_.resize(max_chunk);
+    }
+    batch_srcs_.clear();
+    batch_index_.clear();
+    StageTimings total;
+
+    // 结果先写入分块缓冲再拷贝到 results：跳过空图后同一块的下标不一定连续
+    auto flush = [&]() {
+        if (batch_srcs_.empty()) return;
+        const int n = int(batch_srcs_.size());
+        run_batch(sync_slot_, batch_srcs_.data(), n, batch_outs_.data());
+        total.preprocess_ms += sync_slot_.timings.preprocess_ms;
+        total.infer_ms += sync_slot_.timings.infer_ms;
+        total.postprocess_ms += sync_slot_.timings.postprocess_ms;
+        for (int k = 0; k < n; ++k) {
+            results[batch_index_[k]].assign(batch_outs_[k].begin(), batch_outs_[k].end());
+        }
+        batch_srcs_.clear();
+        batch_index_.clear();
+    };
+
+    for (size_t i = 0; i < src_imgs.size(); ++i) {
+        if (src_imgs[i].empty()) {
+            results[i].clear();
+            continue;
+        }
+        // 图内预处理时同一批必须尺寸一致，尺寸变化处切分
+        if (config_.graph_preprocess && !batch_srcs_.empty() &&
+            batch_srcs_.front()->size() != src_imgs[i].size()) {
+            flush();
+        }
+        batch_srcs_.push_back(&src_imgs[i]);
+        batch_index_.push_back(i);
+        if (batch_srcs_.size() == max_chunk) {
+            flush();
+        }
+    }
+    flush();
+    sync_slot_.timings = total;
+}
+
+void Detector::Detect(const cv::Mat& src_img, std::vector<Blade>& blades)
+{
+    blades.clear();
+    if (src_img.empty()) {
+        std::cerr << "Empty image!" << std::endl;
+        return;
+    }
+
+    // 借出期间该槽只被当前线程使用，同步推理不会触发异步回调
+    SlotLease lease(*this);
+    const cv::Mat* src = &src_img;
+    run_batch(lease.slot(), &src, 1, &blades);
+}
+
+bool Detector::CanShareInput(const Detector& other) const
+{
+    return this != &other &&
+           input_size_ == other.input_size_ &&
+           config_.graph_preprocess == other.config_.graph_preprocess &&
+           config_.batch_size == other.config_.batch_size;
+}
+
+void Detector::StartDetect(const cv::Mat& src_img)
+{
+    const cv::Mat* src = &src_img;
+    const auto start = Clock::now();
+    prepare_inputs(sync_slot_, &src, 1, false);
+    sync_slot_.started = Clock::now();
+    sync_slot_.timings.preprocess_ms = elapsed_ms(start, sync_slot_.started);
+    sync_slot_.request.start_async();
+}
+
+void Detector::StartDetectShared(Detector& source)
+{
+    if (!CanShareInput(source)) {
+        throw std::invalid_argument("detectors do not share the same input layout");
+    }
+
+    // 直接把来源检测器已预处理好的输入张量交给本模型，省去一次 letterbox 和归一化
+    sync_slot_.request.set_input_tensor(0, source.sync_slot_.request.get_input_tensor(0));
+    sync_slot_.lb = source.sync_slot_.lb;
+    sync_slot_.input_shared = true;
+    sync_slot_.timings.preprocess_ms = 0.0;
+    sync_slot_.started = Clock::now();
+    sync_slot_.request.start_async();
+}
+
+const std::vector<Blade>& Detector::WaitDetect()
+{
+    sync_slot_.request.wait();
+    const auto finished = Clock::now();
+    sync_slot_.timings.infer_ms = elapsed_ms(sync_slot_.started, finished);
+    if (candidate_floor_ > 0.0f) {
+        return detect_cached(cv::Point());
+    }
+
+    auto output = sync_slot_.request.get_output_tensor(0);
+    non_max_suppression(output, 1, conf_threshold_, nms_threshold_, sync_slot_.lb.data(),
+                        sync_slot_.scratch, &blade_array_);
+    sync_slot_.timings.postprocess_ms = elapsed_ms(finished, Clock::now());
+    return blade_array_;
+}
+
+void Detector::setCandidateFloor(float floor)
+{
+    candidate_floor_ = std::max(0.0f, floor);
+    candidate_cache_.valid = false;
+    if (candidate_floor_ > 0.0f) {
+        // 与同步槽的后处理缓冲同样按 anchor 总数预留
+        const size_t num_anchors = compiled_model_.output().get_partial_shape()[2].get_length();
+        candidate_cache_.candidates.reserve(num_anchors, KPT_NUM);
+    }
+}
+
+bool Detector::CanRefilter() const
+{
+    return candidate_cache_.valid && conf_threshold_ >= candidate_cache_.threshold;
+}
+
+void Detector::infer_sync(const cv::Mat* src)
+{
+    const auto start = Clock::now();
+    prepare_inputs(sync_slot_, &src, 1, false);
+    const auto prepared = Clock::now();
+    sync_slot_.request.infer();
+    sync_slot_.timings.preprocess_ms = elapsed_ms(start, prepared);
+    sync_slot_.timings.infer_ms = elapsed_ms(prepared, Clock::now());
+}
+
+const std::vector<Blade>& Detector::detect_cached(const cv::Point& offset)
+{
+    const auto start = Clock::now();
+    CandidateCache& cache = candidate_cache_;
+    const auto output = sync_slot_.request.get_output_tensor(0);
+    cache.threshold = std::min(candidate_floor_, conf_threshold_);
+    decode_fn_(output.data<const float>(), 1, num_anchors_,
+               cache.threshold, float(input_size_), cache.candidates);
+    // 扫描用的下标缓冲不需要随候选一起拷贝
+    cache.candidates.survivors.clear();
+    cache.lb = sync_slot_.lb[0];
+    cache.offset = offset;
+    cache.valid = true;
+    Refilter();
+    sync_slot_.timings.postprocess_ms = elapsed_ms(start, Clock::now());
+    return blade_array_;
+}
+
+const std::vector<Blade>& Detector::Refilter()
+{
+    if (!CanRefilter()) {
+        throw std::logic_error("no cached candidates cover the current confidence threshold");
+    }
+
+    // 拷贝到后处理暂存区后筛选，缓存本身保持不变；容量已预留，不分配内存
+    NmsScratch& scratch = sync_slot_.scratch;
+    scratch.candidates = candidate_cache_.candidates;
+    filter_candidates(scratch.candidates, conf_threshold_);
+    finish_detections(1, nms_threshold_, &candidate_cache_.lb, scratch, &blade_array_);
+
+    const cv::Point& offset = candidate_cache_.offset;
+    if (offset != cv::Point()) {
+        const cv::Point2f shift(static_cast<float>(offset.x), static_cast<float>(offset.y));
+        for (Blade& blade : blade_array_) {
+            blade.rect.x += offset.x;
+            blade.rect.y += offset.y;
+            for (cv::Point2f& point : blade.kpt) {
+                if (point.x >= 0 && point.y >= 0) {
+                    point += shift;
+                }
+            }
+        }
+    }
+    return blade_array_;
+}
+
+void Detector::run_batch(InferSlot& slot, const cv::Mat* const* srcs, int n,
+                         std::vector<Blade>* outs)
+{
+    const auto start = Clock::now();
+    prepare_inputs(slot, srcs, n, false);
+    const auto prepared = Clock::now();
 
     // 执行推理
-    infer_request_.infer();
+    slot.request.infer();
+    const auto inferred = Clock::now();
 
     // 获取输出
-    auto output = infer_request_.get_output_tensor(0);
+    auto output = slot.request.get_output_tensor(0);
 
     // 执行NMS和后处理
-    non_max_suppression(output, conf_threshold_, nms_threshold_, src_img.size());
+    non_max_suppression(output, n, conf_threshold_, nms_threshold_, slot.lb.data(),
+                        slot.scratch, outs);
 
-    return blade_array_;
+    slot.timings.preprocess_ms = elapsed_ms(start, prepared);
+    slot.timings.infer_ms = elapsed_ms(prepared, inferred);
+    slot.timings.postprocess_ms = elapsed_ms(inferred, Clock::now());
 }
 
-cv::Mat Detector::letterbox(cv::Mat& src, int h, int w)
+void Detector::DetectAsync(const cv::Mat& src_img, DetectCallback callback)
 {
-    int in_w = src.cols;
-    int in_h = src.rows;
-    int tar_w = w;
-    int tar_h = h;
-    float r = std::min(float(tar_h) / in_h, float(tar_w) / in_w);
-    int inside_w = round(in_w * r);
-    int inside_h = round(in_h * r);
-    padd_w_ = tar_w - inside_w;
-    padd_h_ = tar_h - inside_h;
+    // 错误原样交给回调，与 future 版本的 set_exception 对应
+    if (!callback) {
+        callback = [](std::vector<Blade>, std::exception_ptr) {};
+    }
+    submit(src_img, std::move(callback));
+}
 
-    cv::Mat resize_img;
-    cv::resize(src, resize_img, cv::Size(inside_w, inside_h));
+std::future<std::vector<Blade>> Detector::DetectAsync(const cv::Mat& src_img)
+{
+    // std::function 要求可拷贝，promise 通过 shared_ptr 持有
+    auto promise = std::make_shared<std::promise<std::vector<Blade>>>();
+    std::future<std::vector<Blade>> future = promise->get_future();
 
-    padd_w_ = padd_w_ / 2;
-    padd_h_ = padd_h_ / 2;
+    submit(src_img, [promise](std::vector<Blade> blades, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        } else {
+            promise->set_value(std::move(blades));
+        }
+    });
 
-    int top = int(round(padd_h_ - 0.1));
-    int bottom = int(round(padd_h_ + 0.1));
-    int left = int(round(padd_w_ - 0.1));
-    int right = int(round(padd_w_ + 0.1));
+    return future;
+}
 
-    cv::copyMakeBorder(
-        resize_img, resize_img, top, bottom, left, right,
-        cv::BORDER_CONSTANT, cv::Scalar(114, 114, 114)
-    );
+void Detector::DetectPooled(const cv::Mat* srcs, int n, std::vector<Blade>* outs,
+                            StageTimings* timings)
+{
+    {
+        std::lock_guard<std::mutex> lock(pooled_.mutex);
+        pooled_.pending = 0;
+        pooled_.timings = StageTimings();
+        pooled_.error = nullptr;
+    }
 
-    return resize_img;
-}
+    std::exception_ptr error;
+    for (int i = 0; i < n; ++i) {
+        outs[i].clear();
+        if (srcs[i].empty()) {
+            continue;
+        }
 
-void Detector::non_max_suppression(
-    ov::Tensor& output,
-    float conf_thres,
-    float iou_thres,
-    cv::Size img_size)
-{
-    auto data = output.data<float>();
-
-    int bs = output.get_shape()[0];
-    int num_detections = output.get_shape()[1];
-    int num_features = output.get_shape()[2];
-
-    std::vector<int> classIds;
-    std::vector<float> confidences;
-    std::vector<cv::Rect> boxes;
-    std::vector<std::vector<cv::Point2f>> kpts_list;
-    std::vector<int> picked;
-    std::vector<float> picked_useless;
-
-    for (int i = 0; i < bs; i++) {
-        for (int j = 0; j < num_detections; j++) {
-            int offset = i * num_detections * num_features + j * num_features;
-
-            float center_x_640 = data[offset + 0];
-            float center_y_640 = data[offset + 1];
-            float width_640 = data[offset + 2];
-            float height_640 = data[offset + 3];
-
-            // 类别置信度处理
-            float class_scores[CLS_NUM];
-            float max_class_score = -FLT_MAX;
-            int classId = 0;
-            for (int k = 0; k < CLS_NUM; k++) {
-                class_scores[k] = data[offset + 4 + k];
-                if (class_scores[k] > max_class_score) {
-                    max_class_score = class_scores[k];
-                    classId = k;
+        InferSlot& slot = acquire_slot();
+        try {
+            // 返回前等待全部请求完成，推理期间原图一直有效，不必拷贝
+            const auto start = Clock::now();
+            const cv::Mat* src = &srcs[i];
+            prepare_inputs(slot, &src, 1, false);
+            slot.conf_thres = conf_threshold_;
+            slot.iou_thres = nms_threshold_;
+            slot.started = Clock::now();
+            slot.timings.preprocess_ms = elapsed_ms(start, slot.started);
+            slot.out = &outs[i];
+            {
+                std::lock_guard<std::mutex> lock(pooled_.mutex);
+                ++pooled_.pending;
+            }
+            begin_callback();
+            slot.request.start_async();
+        } catch (...) {
+            // 启动失败时回调不会执行，撤销计数并归还槽
+            if (slot.out) {
+                {
+                    std::lock_guard<std::mutex> lock(pooled_.mutex);
+                    --pooled_.pending;
                 }
+                end_callback();
             }
+            slot.out = nullptr;
+            release_slot(slot);
+            error = std::current_exception();
+            break;
+        }
+    }
 
-            if (max_class_score < conf_thres) {
-                continue;
-            }
+    std::unique_lock<std::mutex> lock(pooled_.mutex);
+    pooled_.cv.wait(lock, [this] { return pooled_.pending == 0; });
+    if (timings) {
+        *timings = pooled_.timings;
+    }
+    if (!error) {
+        error = pooled_.error;
+    }
+    lock.unlock();
 
-            float x1_640 = center_x_640 - width_640 / 2.0f;
-            float y1_640 = center_y_640 - height_640 / 2.0f;
-
-            classIds.emplace_back(classId);
-            confidences.emplace_back(max_class_score);
-            boxes.emplace_back(cv::Rect(x1_640, y1_640, width_640, height_640));
-
-            // 4个关键点处理
-            std::vector<cv::Point2f> kpts;
-            for (int k = 0; k < KPT_NUM; k++) {
-                int kpt_x_idx = 8 + k * 2;
-                int kpt_y_idx = 8 + k * 2 + 1;
-
-                if (kpt_x_idx < num_features && kpt_y_idx < num_features) {
-                    float kpt_x_640 = data[offset + kpt_x_idx];
-                    float kpt_y_640 = data[offset + kpt_y_idx];
-
-                    if (kpt_x_640 >= 0 && kpt_y_640 >= 0 &&
-                        kpt_x_640 <= 640 && kpt_y_640 <= 640) {
-                        kpts.emplace_back(cv::Point2f(kpt_x_640, kpt_y_640));
-                    } else {
-                        kpts.emplace_back(cv::Point2f(-1, -1));
-                    }
-                } else {
-                    kpts.emplace_back(cv::Point2f(-1, -1));
-                }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void Detector::WaitAll()
+{
+    // 槽空闲不代表回调已结束（槽在回调返回前就已归还），还要等回调计数归零
+    std::unique_lock<std::mutex> lock(slot_mutex_);
+    slot_cv_.wait(lock, [this] {
+        if (callbacks_in_flight_ > 0) return false;
+        for (const auto& slot : slots_) {
+            if (slot->busy) return false;
+        }
+        return true;
+    });
+}
+
+void Detector::submit(const cv::Mat& src_img,
+                      std::function<void(std::vector<Blade>, std::exception_ptr)> done)
+{
+    if (src_img.empty()) {
+        std::cerr << "Empty image!" << std::endl;
+        done({}, nullptr);
+        return;
+    }
+
+    // 取一个空闲的推理槽，全部占用时等待
+    InferSlot* slot = &acquire_slot();
+
+    try {
+        // 预处理在调用线程进行，与其他槽的推理重叠
+        const cv::Mat* src = &src_img;
+        prepare_inputs(*slot, &src, 1, true);
+        slot->conf_thres = conf_threshold_;
+        slot->iou_thres = nms_threshold_;
+        slot->done = std::move(done);
+
+        begin_callback();
+        slot->request.start_async();
+    } catch (...) {
+        // 启动失败时回调不会执行，撤销登记并归还槽
+        if (slot->done) {
+            end_callback();
+        }
+        slot->done = nullptr;
+        release_slot(*slot);
+        throw;
+    }
+}
+
+Detector::InferSlot& Detector::acquire_slot()
+{
+    InferSlot* slot = nullptr;
+    std::unique_lock<std::mutex> lock(slot_mutex_);
+    slot_cv_.wait(lock, [this, &slot] {
+        for (auto& s : slots_) {
+            if (!s->busy) {
+                slot = s.get();
+                return true;
             }
-            kpts_list.emplace_back(kpts);
         }
+        return false;
+    });
+    slot->busy = true;
+    return *slot;
+}
+
+void Detector::release_slot(InferSlot& slot)
+{
+    // 在锁内通知：回调线程归还槽后，等待方可能立即返回并析构检测器
+    std::lock_guard<std::mutex> lock(slot_mutex_);
+    slot.busy = false;
+    slot_cv_.notify_all();
+}
+
+void Detector::begin_callback()
+{
+    std::lock_guard<std::mutex> lock(slot_mutex_);
+    ++callbacks_in_flight_;
+}
+
+void Detector::end_callback()
+{
+    std::lock_guard<std::mutex> lock(slot_mutex_);
+    --callbacks_in_flight_;
+    slot_cv_.notify_all();
+}
+
+void Detector::finish_pooled(InferSlot& slot, std::exception_ptr error)
+{
+    const auto finished = Clock::now();
+    if (!error) {
+        try {
+            auto output = slot.request.get_output_tensor(0);
+            non_max_suppression(output, 1, slot.conf_thres, slot.iou_thres, slot.lb.data(),
+                                slot.scratch, slot.out);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    StageTimings timings = slot.timings;
+    timings.infer_ms = elapsed_ms(slot.started, finished);
+    timings.postprocess_ms = elapsed_ms(finished, Clock::now());
+
+    // 先归还槽，DetectPooled 返回时所有槽都已空闲
+    slot.out = nullptr;
+    release_slot(slot);
+    {
+        std::lock_guard<std::mutex> lock(pooled_.mutex);
+        pooled_.timings.preprocess_ms += timings.preprocess_ms;
+        pooled_.timings.infer_ms += timings.infer_ms;
+        pooled_.timings.postprocess_ms += timings.postprocess_ms;
+        if (error && !pooled_.error) {
+            pooled_.error = error;
+        }
+        --pooled_.pending;
+        // 在锁内通知：DetectPooled 返回后检测器可能随即析构
+        pooled_.cv.notify_all();
+    }
+}
+
+void Detector::onSlotFinished(InferSlot& slot, std::exception_ptr error)
+{
+    if (slot.out) {
+        finish_pooled(slot, error);
+        end_callback();
+        return;
+    }
+
+    std::vector<Blade> blades;
+    if (!error) {
+        try {
+            auto output = slot.request.get_output_tensor(0);
+            non_max_suppression(output, 1, slot.conf_thres, slot.iou_thres, slot.lb.data(),
+                                slot.scratch, &blades);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    // 先释放槽再回调，允许在回调中继续提交下一帧
+    std::function<void(std::vector<Blade>, std::exception_ptr)> done = std::move(slot.done);
+    slot.done = nullptr;
+    release_slot(slot);
+
+    if (done) {
+        try {
+            done(std::move(blades), error);
+        } catch (...) {
+            end_callback();
+            throw;
+        }
+    }
+    end_callback();
+}
+
+void Detector::prepare_inputs(InferSlot& slot, const cv::Mat* const* srcs, int n,
+                              bool copy_frames)
+{
+    if (int(slot.lb.size()) < n) {
+        slot.lb.resize(n);
+    }
+
+    // 上一次推理借用了其他检测器的输入，先换回自己的输入张量
+    if (slot.input_shared) {
+        if (config_.graph_preprocess) {
+            slot.frame_tensor = ov::Tensor();
+        } else {
+            slot.request.set_input_tensor(0, slot.own_input);
+        }
+        slot.input_shared = false;
     }
 
-    // 应用NMS
-    cv::dnn::NMSBoxes(boxes, confidences, conf_thres, iou_thres, picked);
+    if (!config_.graph_preprocess) {
+        bind_input_views(slot, n);
+        for (int b = 0; b < n; ++b) {
+            letterbox(*srcs[b], slot.canvas[b], slot.lb[b], slot.canvas_lb[b]);
+
+            // 归一化到[0,1]，直接写入请求自己的输入张量
+            slot.canvas[b].convertTo(slot.input[b], CV_32FC3, 1.0 / 255.0);
+        }
+        return;
+    }
+
+    const cv::Mat& first = *srcs[0];
+    for (int b = 0; b < n; ++b) {
+        if (srcs[b]->type() != CV_8UC3 || srcs[b]->size() != first.size()) {
+            throw std::invalid_argument(
+                "graph preprocessing expects 8-bit BGR input of the same size within a batch");
+        }
+        // 图内完成 letterbox，这里只计算填充量供后处理映射坐标
+        slot.lb[b] = letterbox_info(first.size(), input_size_, input_size_);
+    }
+
+    const int batch = config_.batch_size > 0 ? config_.batch_size : n;
+    const cv::Mat* frame = &first;
+    if (batch > 1 || copy_frames || !first.isContinuous()) {
+        // 多张图拼成一块连续缓冲；异步槽也必须拷贝，防止调用方在推理期间复用缓冲
+        if (slot.frame.rows != batch * first.rows || slot.frame.cols != first.cols) {
+            slot.frame = cv::Mat::zeros(batch * first.rows, first.cols, CV_8UC3);
+        }
+        for (int b = 0; b < n; ++b) {
+            cv::Mat dst = slot.frame.rowRange(b * first.rows, (b + 1) * first.rows);
+            srcs[b]->copyTo(dst);
+        }
+        frame = &slot.frame;
+    }
 
-    // 构建最终结果
-    blade_array_.clear();
+    // 地址和尺寸不变时复用已有的张量包装，比较记下的尺寸而不是每帧构造 ov::Shape
+    const cv::Size frame_size(first.cols, first.rows);
+    if (!slot.frame_tensor || slot.frame_tensor.data() != frame->data ||
+        slot.frame_batch != batch || slot.frame_size != frame_size) {
+        slot.frame_tensor = ov::Tensor(ov::element::u8,
+                                       {size_t(batch), size_t(first.rows), size_t(first.cols), 3},
+                                       frame->data);
+        slot.request.set_input_tensor(0, slot.frame_tensor);
+        slot.frame_batch = batch;
+        slot.frame_size = frame_size;
+    }
+}
+
+LetterboxInfo Detector::letterbox_info(const cv::Size& src_size, int h, int w) const
+{
+    float r = std::min(float(h) / src_size.height, float(w) / src_size.width);
+    int inside_w = round(src_size.width * r);
+    int inside_h = round(src_size.height * r);
+
+    LetterboxInfo lb;
+    lb.padd_w = (w - inside_w) / 2.0f;
+    lb.padd_h = (h - inside_h) / 2.0f;
+    lb.src_size = src_size;
+    return lb;
+}
+
+void Detector::letterbox(const cv::Mat& src, cv::Mat& canvas, LetterboxInfo& lb,
+                         LetterboxInfo& canvas_lb) const
+{
+    lb = letterbox_info(src.size(), canvas.rows, canvas.cols);
+
+    int inside_w = canvas.cols - int(round(2 * lb.padd_w));
+    int inside_h = canvas.rows - int(round(2 * lb.padd_h));
+    int top = int(round(lb.padd_h - 0.1));
+    int left = int(round(lb.padd_w - 0.1));
+
+    // 填充区域只在缩放尺寸变化时重画
+    if (canvas_lb.padd_w != lb.padd_w || canvas_lb.padd_h != lb.padd_h) {
+        canvas.setTo(cv::Scalar(114, 114, 114));
+        canvas_lb = lb;
+    }
+
+    // 直接缩放进画布的中间区域，不产生中间图像
+    cv::Mat inside = canvas(cv::Rect(left, top, inside_w, inside_h));
+    cv::resize(src, inside, inside.size());
+}
+
+void Detector::non_max_suppression(
+    const ov::Tensor& output,
+    int num_images,
+    float conf_thres,
+    float iou_thres,
+    const LetterboxInfo* lbs,
+    NmsScratch& scratch,
+    std::vector<Blade>* outs) const
+{
+    const float* data = output.data<const float>();
+
+    // 输出为原生布局 [bs, num_features, num_anchors]，只解码实际填充的前 num_images 张
+    // （输出 batch 不小于填充的图像数，anchor 数在加载时已记下）
+    int bs = num_images;
+    int num_detections = num_anchors_;
+
+    CandidateBuffer& cand = scratch.candidates;
+
+    // 向量化扫描类别分数，只解码通过阈值的候选（按加载时选定的检测头布局）
+    decode_fn_(data, bs, num_detections, conf_thres, float(input_size_), cand);
+
+    finish_detections(num_images, iou_thres, lbs, scratch, outs);
+}
+
+void Detector::finish_detections(int num_images, float iou_thres, const LetterboxInfo* lbs,
+                                 NmsScratch& scratch, std::vector<Blade>* outs) const
+{
+    const CandidateBuffer& cand = scratch.candidates;
+    std::vector<int>& picked = scratch.keep;
+
+    // 浮点精度 NMS，直接在候选缓冲上进行
+    NmsOptions nms_opts;
+    nms_opts.iou_thres = iou_thres;
+    nms_opts.class_agnostic = config_.nms_class_agnostic;
+    nms_opts.max_det = config_.max_det;
+    rm_buff::non_max_suppression(cand, nms_opts, scratch.nms, picked);
+
+    // 构建最终结果，按所属图像分发并使用各自的 letterbox 参数
+    for (int b = 0; b < num_images; ++b) {
+        outs[b].clear();
+    }
     for (size_t i = 0; i < picked.size(); ++i) {
         Blade blade;
         int idx = picked[i];
-
-        cv::Rect box_640 = boxes[idx];
+        const LetterboxInfo& lb = lbs[cand.batch[idx]];
+        const cv::Size img_size = lb.src_size;
 
         // 坐标转换函数
-        auto convert_coord = [&](float coord_640, bool is_x) -> float {
+        auto convert_coord = [&](float coord_net, bool is_x) -> float {
             if (is_x) {
-                return (coord_640 - padd_w_) * img_size.width /
-                       (buff_image_size - 2 * padd_w_);
+                return (coord_net - lb.padd_w) * img_size.width /
+                       (input_size_ - 2 * lb.padd_w);
             } else {
-                return (coord_640 - padd_h_) * img_size.height /
-                       (buff_image_size - 2 * padd_h_);
+                return (coord_net - lb.padd_h) * img_size.height /
+                       (input_size_ - 2 * lb.padd_h);
             }
         };
 
         // 转换边界框坐标
-        float x1_orig = convert_coord(box_640.x, true);
-        float y1_orig = convert_coord(box_640.y, false);
-        float x2_orig = convert_coord(box_640.x + box_640.width, true);
-        float y2_orig = convert_coord(box_640.y + box_640.height, false);
+        float x1_orig = convert_coord(scratch.nms.x1[idx], true);
+        float y1_orig = convert_coord(scratch.nms.y1[idx], false);
+        float x2_orig = convert_coord(scratch.nms.x2[idx], true);
+        float y2_orig = convert_coord(scratch.nms.y2[idx], false);
 
         x1_orig = std::max(0.0f, std::min(x1_orig, float(img_size.width)));
         y1_orig = std::max(0.0f, std::min(y1_orig, float(img_size.height)));
@@ -215,56 +1119,69 @@ void Detector::non_max_suppression(
         blade.rect = cv::Rect(x1_orig, y1_orig, x2_orig - x1_orig, y2_orig - y1_orig);
 
         // 转换关键点坐标
-        std::vector<cv::Point2f> converted_kpts;
-        for (const auto& kpt_640 : kpts_list[idx]) {
-            if (kpt_640.x >= 0 && kpt_640.y >= 0) {
-                float kpt_x_orig = convert_coord(kpt_640.x, true);
-                float kpt_y_orig = convert_coord(kpt_640.y, false);
+        for (int k = 0; k < KPT_NUM; k++) {
+            const cv::Point2f kpt_net(cand.kpt[(idx * KPT_NUM + k) * 2],
+                                      cand.kpt[(idx * KPT_NUM + k) * 2 + 1]);
+            if (kpt_net.x >= 0 && kpt_net.y >= 0) {
+                float kpt_x_orig = convert_coord(kpt_net.x, true);
+                float kpt_y_orig = convert_coord(kpt_net.y, false);
 
                 kpt_x_orig = std::max(0.0f, std::min(kpt_x_orig, float(img_size.width)));
                 kpt_y_orig = std::max(0.0f, std::min(kpt_y_orig, float(img_size.height)));
 
-                converted_kpts.emplace_back(cv::Point2f(kpt_x_orig, kpt_y_orig));
+                blade.kpt[k] = cv::Point2f(kpt_x_orig, kpt_y_orig);
             } else {
-                converted_kpts.emplace_back(cv::Point2f(-1, -1));
+                blade.kpt[k] = cv::Point2f(-1, -1);
             }
         }
 
-        blade.label = class_names[classIds[idx]];
-        blade.prob = confidences[idx];
-        blade.kpt = converted_kpts;
+        blade.cls = static_cast<BladeClass>(class_base_ + cand.class_id[idx]);
+        blade.prob = cand.score[idx];
 
-        blade_array_.emplace_back(blade);
+        outs[cand.batch[idx]].emplace_back(blade);
     }
 }
 
+const char* class_name(BladeClass cls)
+{
+    static const char* const names[] = {"RR", "RW", "BR", "BW", "BLUE", "RED", "GRAY", "PURPLE"};
+    const size_t index = static_cast<size_t>(cls);
+    return index < sizeof(names) / sizeof(names[0]) ? names[index] : "?";
+}
+
 void Detector::draw_blade(cv::Mat& img)
 {
-    for (size_t i = 0; i < blade_array_.size(); ++i) {
-        if (blade_array_[i].label == "RW" || blade_array_[i].label == "BW")
+    draw_blade(img, blade_array_);
+}
+
+void Detector::draw_blade(cv::Mat& img, const std::vector<Blade>& blades)
+{
+    // 关键点颜色和名称
+    static const cv::Scalar kpt_colors[KPT_NUM] = {
+        cv::Scalar(0, 255, 0),    // kpt0 - 绿色
+        cv::Scalar(255, 0, 0),    // kpt1 - 蓝色
+        cv::Scalar(0, 0, 255),    // kpt2 - 红色
+        cv::Scalar(255, 255, 0)   // kpt3 - 青色
+    };
+    static const char* const kpt_names[KPT_NUM] = {"kpt0", "kpt1", "kpt2", "kpt3"};
+
+    for (size_t i = 0; i < blades.size(); ++i) {
+        if (is_inactive(blades[i].cls))
             continue;
         // 绘制边界框
-        cv::rectangle(img, blade_array_[i].rect, cv::Scalar(0, 255, 0), 2);
+        cv::rectangle(img, blades[i].rect, cv::Scalar(0, 255, 0), 2);
 
         // 绘制标签
-        std::string label = blade_array_[i].label + ": " +
-                           std::to_string(int(blade_array_[i].prob * 100)) + "%";
+        char label[32];
+        std::snprintf(label, sizeof(label), "%s: %d%%",
+                      class_name(blades[i].cls), int(blades[i].prob * 100));
         cv::putText(img, label,
-                    cv::Point(blade_array_[i].rect.x, blade_array_[i].rect.y - 10),
+                    cv::Point(blades[i].rect.x, blades[i].rect.y - 10),
                     cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 0), 2);
 
         // 绘制关键点
-        std::vector<cv::Scalar> kpt_colors = {
-            cv::Scalar(0, 255, 0),    // kpt0 - 绿色
-            cv::Scalar(255, 0, 0),    // kpt1 - 蓝色
-            cv::Scalar(0, 0, 255),    // kpt2 - 红色
-            cv::Scalar(255, 255, 0)   // kpt3 - 青色
-        };
-
-        std::vector<std::string> kpt_names = {"kpt0", "kpt1", "kpt2", "kpt3"};
-
-        for (size_t j = 0; j < blade_array_[i].kpt.size() && j < kpt_colors.size(); ++j) {
-            cv::Point2f kpt = blade_array_[i].kpt[j];
+        for (int j = 0; j < KPT_NUM; ++j) {
+            cv::Point2f kpt = blades[i].kpt[j];
             if (kpt.x >= 0 && kpt.y >= 0 && kpt.x != -1 && kpt.y != -1) {
                 cv::circle(img, cv::Point(kpt.x, kpt.y), 5, kpt_colors[j], -1);
 
@@ -275,16 +1192,18 @@ void Detector::draw_blade(cv::Mat& img)
         }
 
         // 连接关键点形成四边形
-        std::vector<cv::Point> valid_pts;
-        for (size_t j = 0; j < blade_array_[i].kpt.size() && j < 4; ++j) {
-            cv::Point2f kpt = blade_array_[i].kpt[j];
+        cv::Point valid_pts[KPT_NUM];
+        int num_valid = 0;
+        for (int j = 0; j < KPT_NUM; ++j) {
+            cv::Point2f kpt = blades[i].kpt[j];
             if (kpt.x >= 0 && kpt.y >= 0 && kpt.x != -1 && kpt.y != -1) {
-                valid_pts.push_back(cv::Point(kpt.x, kpt.y));
+                valid_pts[num_valid++] = cv::Point(kpt.x, kpt.y);
             }
         }
 
-        if (valid_pts.size() == 4) {
-            cv::polylines(img, valid_pts, true, cv::Scalar(255, 0, 255), 2);
+        if (num_valid == 4) {
+            const cv::Point* contours[] = {valid_pts};
+            cv::polylines(img, contours, &num_valid, 1, true, cv::Scalar(255, 0, 255), 2);
         }
     }
 }
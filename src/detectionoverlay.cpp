@@ -0,0 +1,162 @@
+#include "detectionoverlay.h"
+#include <QFontDatabase>
+#include <QPolygonF>
+#include <algorithm>
+
+namespace
+{
+
+// 关键点颜色和名称，与 Detector::draw_blade 一致
+const QColor kKptColors[rm_buff::BLADE_KPT_NUM] = {
+    QColor(0, 255, 0),      // kpt0 - 绿色
+    QColor(0, 0, 255),      // kpt1 - 蓝色
+    QColor(255, 0, 0),      // kpt2 - 红色
+    QColor(0, 255, 255)     // kpt3 - 青色
+};
+const char* const kKptNames[rm_buff::BLADE_KPT_NUM] = {"kpt0", "kpt1", "kpt2", "kpt3"};
+
+bool validKpt(const cv::Point2f& kpt)
+{
+    return kpt.x >= 0 && kpt.y >= 0;
+}
+
+} // namespace
+
+void DetectionOverlay::paint(QPainter& painter, const DetectionResult& overlay,
+                             qreal scale, const OverlayStyle& style)
+{
+    if (overlay.isEmpty() || scale <= 0) {
+        return;
+    }
+
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setBrush(Qt::NoBrush);
+
+    QFont font = painter.font();
+    font.setPixelSize(12);
+    painter.setFont(font);
+    const QFontMetrics metrics(font);
+
+    // 分块 / 跟踪裁剪区域
+    if (style.showRegions) {
+        painter.setPen(QPen(QColor(128, 128, 128), 1));
+        for (const cv::Rect& r : overlay.regions) {
+            painter.drawRect(QRectF(r.x * scale, r.y * scale, r.width * scale, r.height * scale));
+        }
+    }
+
+    const QPen boxPen(QColor(0, 255, 0), style.lineWidth);
+    const QPen quadPen(QColor(255, 0, 255), style.lineWidth);
+
+    for (const rm_buff::Blade& blade : overlay.blades) {
+        if (rm_buff::is_inactive(blade.cls))
+            continue;
+
+        const QRectF box(blade.rect.x * scale, blade.rect.y * scale,
+                         blade.rect.width * scale, blade.rect.height * scale);
+
+        // 边界框
+        if (style.showBoxes) {
+            painter.setPen(boxPen);
+            painter.drawRect(box);
+        }
+
+        // 标签：显示分辨率下字号固定，靠近上边缘时画在框内
+        if (style.showLabels) {
+            const QString text = QString("%1: %2%")
+                .arg(QLatin1String(rm_buff::class_name(blade.cls)))
+                .arg(static_cast<int>(blade.prob * 100));
+            qreal y = box.top() - 4;
+            if (y - metrics.ascent() < 0) {
+                y = box.top() + metrics.ascent() + 2;
+            }
+            painter.setPen(QColor(0, 255, 0));
+            painter.drawText(QPointF(box.left(), y), text);
+        }
+
+        if (!style.showKeypoints) {
+            continue;
+        }
+
+        // 关键点
+        QPolygonF quad;
+        for (int j = 0; j < rm_buff::BLADE_KPT_NUM; ++j) {
+            const cv::Point2f& kpt = blade.kpt[j];
+            if (!validKpt(kpt)) {
+                continue;
+            }
+            const QPointF p(kpt.x * scale, kpt.y * scale);
+            quad << p;
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(kKptColors[j]);
+            painter.drawEllipse(p, 4.0, 4.0);
+            painter.setBrush(Qt::NoBrush);
+            painter.setPen(kKptColors[j]);
+            painter.drawText(p + QPointF(6, -6), kKptNames[j]);
+        }
+
+        // 连接关键点形成四边形
+        if (quad.size() == rm_buff::BLADE_KPT_NUM) {
+            painter.setPen(quadPen);
+            painter.drawPolygon(quad);
+        }
+    }
+
+    // 提示信息
+    if (!overlay.message.isEmpty()) {
+        QFont messageFont = painter.font();
+        messageFont.setPixelSize(20);
+        painter.setFont(messageFont);
+        painter.setPen(QColor(255, 0, 0));
+        painter.drawText(QPointF(20, 40), overlay.message);
+    }
+
+    painter.restore();
+}
+
+QImage DetectionOverlay::render(const QImage& image, const DetectionResult& overlay,
+                                const OverlayStyle& style)
+{
+    QImage result = image.convertToFormat(QImage::Format_RGB32);
+    if (overlay.isEmpty()) {
+        return result;
+    }
+
+    // 线宽和字号按原图与常见显示宽度的比例放大，保存的图片与屏幕上观感一致
+    const qreal factor = std::max<qreal>(1.0, result.width() / 1280.0);
+
+    QPainter painter(&result);
+    painter.scale(factor, factor);
+    paint(painter, overlay, 1.0 / factor, style);
+    return result;
+}
+
+void DetectionOverlay::paintHud(QPainter& painter, const QStringList& lines)
+{
+    if (lines.isEmpty()) {
+        return;
+    }
+
+    painter.save();
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPixelSize(12);
+    painter.setFont(font);
+    const QFontMetrics metrics(font);
+
+    int width = 0;
+    for (const QString& line : lines) {
+        width = std::max(width, metrics.boundingRect(line).width());
+    }
+    const int padding = 6;
+    const QRect panel(8, 8, width + 2 * padding, lines.size() * metrics.height() + 2 * padding);
+    painter.fillRect(panel, QColor(0, 0, 0, 160));
+
+    painter.setPen(QColor(255, 255, 255));
+    int y = panel.top() + padding + metrics.ascent();
+    for (const QString& line : lines) {
+        painter.drawText(QPoint(panel.left() + padding, y), line);
+        y += metrics.height();
+    }
+    painter.restore();
+}
@@ -0,0 +1,29 @@
+#include "detectionresult.h"
+
+DetectionResultPool::DetectionResultPool(size_t maxSize, size_t reserveBlades)
+    : maxSize_(maxSize)
+    , reserveBlades_(reserveBlades)
+{
+    items_.reserve(maxSize_);
+}
+
+std::shared_ptr<DetectionResult> DetectionResultPool::acquire()
+{
+    // 从上次的位置开始轮询，use_count 为 1 说明只有池持有，可以安全复用
+    for (size_t i = 0; i < items_.size(); ++i) {
+        const size_t index = (next_ + i) % items_.size();
+        if (items_[index].use_count() == 1) {
+            next_ = index + 1;
+            items_[index]->clear();
+            return items_[index];
+        }
+    }
+
+    auto item = std::make_shared<DetectionResult>();
+    item->blades.reserve(reserveBlades_);
+    if (items_.size() < maxSize_) {
+        items_.push_back(item);
+        next_ = 0;
+    }
+    return item;
+}
@@ -0,0 +1,86 @@
+#include "detectorgroup.h"
+#include <exception>
+
+namespace rm_buff
+{
+
+void DetectorGroup::add(Detector* detector)
+{
+    // 与已有的自行预处理的检测器比较，能共享就借用它的输入
+    int source = -1;
+    for (size_t i = 0; i < detectors_.size(); ++i) {
+        if (share_source_[i] < 0 && detector->CanShareInput(*detectors_[i])) {
+            source = static_cast<int>(i);
+            break;
+        }
+    }
+
+    detectors_.push_back(detector);
+    share_source_.push_back(source);
+    results_.push_back(&empty_);
+
+    // 启动顺序：先启动自行预处理的检测器，再启动共享输入的检测器
+    order_.clear();
+    for (size_t i = 0; i < detectors_.size(); ++i) {
+        if (share_source_[i] < 0) order_.push_back(i);
+    }
+    for (size_t i = 0; i < detectors_.size(); ++i) {
+        if (share_source_[i] >= 0) order_.push_back(i);
+    }
+}
+
+void DetectorGroup::clear()
+{
+    detectors_.clear();
+    share_source_.clear();
+    order_.clear();
+    results_.clear();
+    blades_.clear();
+}
+
+const std::vector<Blade>& DetectorGroup::Detect(const cv::Mat& src_img)
+{
+    blades_.clear();
+    if (src_img.empty() || detectors_.empty()) {
+        return blades_;
+    }
+
+    size_t started = 0;
+    try {
+        for (; started < order_.size(); ++started) {
+            const size_t i = order_[started];
+            if (share_source_[i] < 0) {
+                detectors_[i]->StartDetect(src_img);
+            } else {
+                detectors_[i]->StartDetectShared(*detectors_[share_source_[i]]);
+            }
+        }
+    } catch (...) {
+        // 等待已启动的请求结束，避免推理仍在使用输入时缓冲被复用
+        for (size_t k = 0; k < started; ++k) {
+            try {
+                detectors_[order_[k]]->WaitDetect();
+            } catch (...) {
+            }
+        }
+        throw;
+    }
+
+    // 所有请求都要等待完成，出错时在全部结束后抛出第一个异常
+    std::exception_ptr error;
+    for (size_t i = 0; i < detectors_.size(); ++i) {
+        try {
+            results_[i] = &detectors_[i]->WaitDetect();
+            blades_.insert(blades_.end(), results_[i]->begin(), results_[i]->end());
+        } catch (...) {
+            results_[i] = &empty_;
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return blades_;
+}
+
+} // namespace rm_buff
@@ -0,0 +1,114 @@
+#include "framecache.h"
+
+FrameCache::FrameCache(size_t capacityBytes)
+    : capacity_(capacityBytes)
+{
+}
+
+void FrameCache::setCapacity(size_t capacityBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacityBytes;
+    evict();
+}
+
+size_t FrameCache::capacity() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return capacity_;
+}
+
+size_t FrameCache::bytesOf(const Entry& entry)
+{
+    size_t bytes = entry.frame.total() * entry.frame.elemSize();
+    // 原始显示模式下处理结果与原始帧共用数据
+    if (!entry.processed.empty() && entry.processed.data != entry.frame.data) {
+        bytes += entry.processed.total() * entry.processed.elemSize();
+    }
+    return bytes;
+}
+
+void FrameCache::insert(int index, const Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t bytes = bytesOf(entry);
+    if (bytes == 0 || bytes > capacity_) {
+        return;
+    }
+
+    auto found = map_.find(index);
+    if (found != map_.end()) {
+        Entry& old = found->second->second;
+        bytes_ -= bytesOf(old);
+        if (entry.paramsVersion >= 0 || old.paramsVersion < 0) {
+            old = entry;
+        } else {
+            // 只更新原始帧，保留已有的处理结果
+            old.frame = entry.frame;
+            old.timestampMs = entry.timestampMs;
+        }
+        bytes_ += bytesOf(old);
+        items_.splice(items_.begin(), items_, found->second);
+    } else {
+        items_.emplace_front(index, entry);
+        map_[index] = items_.begin();
+        bytes_ += bytes;
+    }
+    evict();
+}
+
+bool FrameCache::lookup(int index, Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = map_.find(index);
+    if (found == map_.end()) {
+        ++misses_;
+        return false;
+    }
+    ++hits_;
+    items_.splice(items_.begin(), items_, found->second);
+    entry = found->second->second;
+    return true;
+}
+
+bool FrameCache::contains(int index) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return map_.count(index) > 0;
+}
+
+void FrameCache::evict()
+{
+    while (bytes_ > capacity_ && !items_.empty()) {
+        bytes_ -= bytesOf(items_.back().second);
+        map_.erase(items_.back().first);
+        items_.pop_back();
+    }
+}
+
+void FrameCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    items_.clear();
+    map_.clear();
+    bytes_ = 0;
+}
+
+void FrameCache::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    hits_ = 0;
+    misses_ = 0;
+}
+
+FrameCache::Stats FrameCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.entries = static_cast<int>(items_.size());
+    stats.bytes = bytes_;
+    stats.capacity = capacity_;
+    return stats;
+}
@@ -0,0 +1,196 @@
+#include "keyframeindex.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <utility>
+
+// 原始码流读取和关键帧标记需要 OpenCV 4.6 及以上的 FFmpeg 后端
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+#define KEYFRAME_INDEX_SUPPORTED 1
+#else
+#define KEYFRAME_INDEX_SUPPORTED 0
+#endif
+
+namespace rm_buff
+{
+
+namespace
+{
+const char kMagic[8] = {'K', 'F', 'I', 'D', 'X', '0', '0', '1'};
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+} // namespace
+
+bool KeyframeIndex::build(const std::string& video_path, const std::atomic<bool>* cancel)
+{
+    clear();
+#if KEYFRAME_INDEX_SUPPORTED
+    cv::VideoCapture capture;
+    if (!capture.open(video_path, cv::CAP_FFMPEG, {cv::CAP_PROP_FORMAT, -1})) {
+        return false;
+    }
+
+    // 码流按解码顺序读出，有 B 帧时时间戳不单调，先收集再按时间戳排序得到显示顺序
+    std::vector<std::pair<double, bool>> packets;
+    while (capture.grab()) {
+        if (cancel && cancel->load()) {
+            return false;
+        }
+        packets.emplace_back(capture.get(cv::CAP_PROP_POS_MSEC),
+                             capture.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) != 0);
+    }
+    std::stable_sort(packets.begin(), packets.end(),
+                     [](const std::pair<double, bool>& a, const std::pair<double, bool>& b) {
+                         return a.first < b.first;
+                     });
+
+    timestamps_.reserve(packets.size());
+    for (size_t i = 0; i < packets.size(); ++i) {
+        timestamps_.push_back(packets[i].first);
+        if (packets[i].second) {
+            keyframes_.push_back(static_cast<int>(i));
+        }
+    }
+    if (keyframes_.empty()) {
+        clear();
+        return false;
+    }
+    return true;
+#else
+    (void)video_path;
+    (void)cancel;
+    return false;
+#endif
+}
+
+bool KeyframeIndex::save(const std::string& index_path, const std::string& signature) const
+{
+    std::ofstream out(index_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    writeValue(out, static_cast<uint32_t>(signature.size()));
+    out.write(signature.data(), static_cast<std::streamsize>(signature.size()));
+    writeValue(out, static_cast<uint32_t>(timestamps_.size()));
+    writeValue(out, static_cast<uint32_t>(keyframes_.size()));
+    out.write(reinterpret_cast<const char*>(timestamps_.data()),
+              static_cast<std::streamsize>(timestamps_.size() * sizeof(double)));
+    out.write(reinterpret_cast<const char*>(keyframes_.data()),
+              static_cast<std::streamsize>(keyframes_.size() * sizeof(int)));
+    return static_cast<bool>(out);
+}
+
+bool KeyframeIndex::load(const std::string& index_path, const std::string& signature)
+{
+    clear();
+    std::ifstream in(index_path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    char magic[sizeof(kMagic)];
+    uint32_t signature_size = 0;
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kMagic) ||
+        !readValue(in, signature_size) || signature_size != signature.size()) {
+        return false;
+    }
+    std::string stored(signature_size, '\0');
+    if (!in.read(&stored[0], signature_size) || stored != signature) {
+        return false;
+    }
+
+    uint32_t frame_count = 0;
+    uint32_t keyframe_count = 0;
+    if (!readValue(in, frame_count) || !readValue(in, keyframe_count) ||
+        keyframe_count == 0 || keyframe_count > frame_count) {
+        return false;
+    }
+    timestamps_.resize(frame_count);
+    keyframes_.resize(keyframe_count);
+    if (!in.read(reinterpret_cast<char*>(timestamps_.data()), frame_count * sizeof(double)) ||
+        !in.read(reinterpret_cast<char*>(keyframes_.data()), keyframe_count * sizeof(int))) {
+        clear();
+        return false;
+    }
+
+    // 损坏的文件：关键帧必须升序且落在帧范围内
+    for (size_t i = 0; i < keyframes_.size(); ++i) {
+        if (keyframes_[i] < 0 || keyframes_[i] >= static_cast<int>(frame_count) ||
+            (i > 0 && keyframes_[i] <= keyframes_[i - 1])) {
+            clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string KeyframeIndex::pathFor(const std::string& video_path)
+{
+    return video_path + ".kfidx";
+}
+
+void KeyframeIndex::clear()
+{
+    keyframes_.clear();
+    timestamps_.clear();
+}
+
+int KeyframeIndex::keyframeAtOrBefore(int frame) const
+{
+    if (keyframes_.empty()) {
+        return 0;
+    }
+    auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), frame);
+    return it == keyframes_.begin() ? keyframes_.front() : *(it - 1);
+}
+
+int KeyframeIndex::nearestKeyframe(int frame) const
+{
+    if (keyframes_.empty()) {
+        return 0;
+    }
+    auto it = std::lower_bound(keyframes_.begin(), keyframes_.end(), frame);
+    if (it == keyframes_.end()) {
+        return keyframes_.back();
+    }
+    if (it == keyframes_.begin()) {
+        return *it;
+    }
+    return (*it - frame) < (frame - *(it - 1)) ? *it : *(it - 1);
+}
+
+int KeyframeIndex::seekCost(int frame) const
+{
+    return frame - std::min(frame, keyframeAtOrBefore(std::max(0, frame - kSeekPreroll)));
+}
+
+bool KeyframeIndex::shouldSeek(int position, int frame) const
+{
+    if (position < 0 || frame < position) {
+        return true;
+    }
+    return frame - position > seekCost(frame);
+}
+
+double KeyframeIndex::timestampMs(int frame) const
+{
+    if (timestamps_.empty()) {
+        return 0.0;
+    }
+    frame = std::max(0, std::min(frame, frameCount() - 1));
+    return timestamps_[static_cast<size_t>(frame)];
+}
+
+} // namespace rm_buff
@@ -0,0 +1,167 @@
+#include "latencystats.h"
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+constexpr double kMinMs = 0.01;
+const double kLogGrowth = std::log(1.1);
+
+} // namespace
+
+LatencyStats::LatencyStats(int window)
+    : window_(std::max(1, window))
+{
+    for (Histogram& h : stages_) {
+        h.samples.assign(window_, 0.0f);
+        h.bins.assign(window_, 0);
+    }
+}
+
+int LatencyStats::bucketOf(double ms)
+{
+    if (!(ms > kMinMs)) {
+        return 0;
+    }
+    const int bucket = static_cast<int>(std::log(ms / kMinMs) / kLogGrowth) + 1;
+    return std::min(bucket, kBuckets - 1);
+}
+
+double LatencyStats::bucketValue(int bucket)
+{
+    if (bucket == 0) {
+        return kMinMs;
+    }
+    // 桶内取几何中点
+    return kMinMs * std::exp((bucket - 0.5) * kLogGrowth);
+}
+
+void LatencyStats::record(Stage stage, double ms)
+{
+    if (stage < 0 || stage >= StageCount) {
+        return;
+    }
+    Histogram& h = stages_[stage];
+    const int bucket = bucketOf(ms);
+
+    std::lock_guard<std::mutex> lock(h.mutex);
+    if (h.size == window_) {
+        // 窗口已满，移出最旧的样本
+        --h.counts[h.bins[h.next]];
+        h.sum -= h.samples[h.next];
+    } else {
+        ++h.size;
+    }
+    h.samples[h.next] = static_cast<float>(ms);
+    h.bins[h.next] = static_cast<uint8_t>(bucket);
+    ++h.counts[bucket];
+    h.sum += ms;
+    h.next = (h.next + 1) % window_;
+}
+
+double LatencyStats::percentile(const Histogram& h, double p, double max)
+{
+    const int rank = std::max(1, static_cast<int>(std::ceil(p * h.size)));
+    int seen = 0;
+    for (int bucket = 0; bucket < kBuckets; ++bucket) {
+        seen += h.counts[bucket];
+        if (seen >= rank) {
+            return std::min(bucketValue(bucket), max);
+        }
+    }
+    return max;
+}
+
+LatencyStats::Summary LatencyStats::summary(Stage stage) const
+{
+    Summary summary;
+    if (stage < 0 || stage >= StageCount) {
+        return summary;
+    }
+    const Histogram& h = stages_[stage];
+
+    std::lock_guard<std::mutex> lock(h.mutex);
+    if (h.size == 0) {
+        return summary;
+    }
+    summary.count = h.size;
+    summary.last = h.samples[(h.next + window_ - 1) % window_];
+    summary.mean = h.sum / h.size;
+    summary.max = *std::max_element(h.samples.begin(), h.samples.begin() + h.size);
+    summary.p50 = percentile(h, 0.50, summary.max);
+    summary.p95 = percentile(h, 0.95, summary.max);
+    summary.p99 = percentile(h, 0.99, summary.max);
+    return summary;
+}
+
+void LatencyStats::reset()
+{
+    for (Histogram& h : stages_) {
+        std::lock_guard<std::mutex> lock(h.mutex);
+        h.counts.fill(0);
+        h.next = 0;
+        h.size = 0;
+        h.sum = 0.0;
+    }
+}
+
+const char* LatencyStats::stageName(Stage stage)
+{
+    switch (stage) {
+        case Decode: return "decode";
+        case Preprocess: return "preprocess";
+        case Inference: return "inference";
+        case Postprocess: return "postprocess";
+        case Process: return "process";
+        case Convert: return "convert";
+        case Scale: return "scale";
+        case Draw: return "draw";
+        case FrameAge: return "frame_age";
+        default: return "unknown";
+    }
+}
+
+bool LatencyStats::writeCsv(const QString& path, QString* error) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "stage,count,last_ms,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+    for (int i = 0; i < StageCount; ++i) {
+        const Stage stage = static_cast<Stage>(i);
+        const Summary s = summary(stage);
+        out << stageName(stage) << ',' << s.count << ','
+            << s.last << ',' << s.mean << ',' << s.p50 << ','
+            << s.p95 << ',' << s.p99 << ',' << s.max << '\n';
+    }
+
+    // 原始样本：阶段、窗口内序号（0 为最旧）、耗时
+    out << "\nstage,sample,ms\n";
+    for (int i = 0; i < StageCount; ++i) {
+        const Histogram& h = stages_[i];
+        std::lock_guard<std::mutex> lock(h.mutex);
+        const int first = h.size == window_ ? h.next : 0;
+        for (int k = 0; k < h.size; ++k) {
+            out << stageName(static_cast<Stage>(i)) << ',' << k << ','
+                << h.samples[(first + k) % window_] << '\n';
+        }
+    }
+
+    out.flush();
+    if (out.status() != QTextStream::Ok) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
@@ -1,16 +1,48 @@
 #include "mainwindow.h"
+#include "batchrunner.h"
 #include <QApplication>
+#include <QCoreApplication>
+#include <QDebug>
 #include <QFile>
 
+// 设置应用程序信息（决定 QSettings 和数据目录的位置）
+static void setApplicationInfo()
+{
+    QCoreApplication::setApplicationName("BuffDetection");
+    QCoreApplication::setApplicationVersion("1.0.0");
+    QCoreApplication::setOrganizationName("flairziv");
+    QCoreApplication::setOrganizationDomain("github.com/flairziv");
+}
+
+// 带 --batch 参数时以无界面模式批量处理，不创建窗口，也不需要显示器
+static bool isBatchMode(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--batch") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
+    if (isBatchMode(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        setApplicationInfo();
 
-    // 设置应用程序信息
-    app.setApplicationName("BuffDetection");
-    app.setApplicationVersion("1.0.0");
-    app.setOrganizationName("flairziv");
-    app.setOrganizationDomain("github.com/flairziv");
+        BatchOptions options;
+        QString error;
+        if (!BatchOptions::parse(app, options, error)) {
+            qCritical().noquote() << error;
+            return 2;
+        }
+        BatchRunner runner(options);
+        return runner.run();
+    }
+
+    QApplication app(argc, argv);
+    setApplicationInfo();
 
     MainWindow w;
     w.show();
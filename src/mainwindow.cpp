@@ -1,15 +1,22 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "settingsdialog.h"
+#include <QApplication>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QStandardPaths>
 #include <QCloseEvent>
 #include <QDateTime>
+#include <QFontDatabase>
+#include <chrono>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , currentZoom_(1.0)
+    , basePixmapKey_(0)
+    , pendingDecodedAtUs_(0)
     , currentTheme_("light")
 {
     ui->setupUi(this);
@@ -30,6 +37,16 @@ MainWindow::MainWindow(QWidget *parent)
             statusBar()->showMessage(tr("成功加载模型"), 3000);
         }
     }
+
+    // 装甲板模型可选：优先使用资源内的模型，其次是程序目录下的 model/armor.xml
+    QString armorPath = ":/models/armor.xml";
+    if (!QFile::exists(armorPath)) {
+        armorPath = QCoreApplication::applicationDirPath() + "/model/armor.xml";
+    }
+    if (QFile::exists(armorPath)) {
+        mediaProcessor->loadArmorModel(armorPath);
+    }
+    ui->armorComboBox->setEnabled(mediaProcessor->hasArmorModel());
 }
 
 MainWindow::~MainWindow()
@@ -48,6 +65,13 @@ void MainWindow::setupUI()
     ui->progressSlider->setVisible(false);
     ui->frameLabel->setVisible(false);
     ui->fpsLabel->setVisible(false);
+    ui->lagLabel->setVisible(false);
+    ui->cacheLabel->setVisible(false);
+
+    // 阶段耗时按列对齐
+    ui->latencyStatsLabel->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    ui->displayLabel->installEventFilter(this);
 
     // 设置显示模式按钮组
     displayModeGroup = new QButtonGroup(this);
@@ -66,6 +90,9 @@ void MainWindow::setupUI()
 
     // 设置初始状态
     ui->originalRadio->setChecked(true);
+    ui->fullDetectIntervalSpinBox->setEnabled(false);
+    ui->motionThresholdSpinBox->setEnabled(false);
+    ui->skippedLabel->setVisible(false);
 
     // 状态栏初始消息
     statusBar()->showMessage(tr("就绪 - 请打开图片或视频文件"));
@@ -96,6 +123,24 @@ void MainWindow::setupConnections()
             this, &MainWindow::actualSize);
     connect(ui->actionToggleLeftPanel, &QAction::toggled,
             this, &MainWindow::toggleLeftPanel);
+    connect(ui->actionShowLabels, &QAction::toggled,
+            this, &MainWindow::onOverlayStyleChanged);
+    connect(ui->actionShowKeypoints, &QAction::toggled,
+            this, &MainWindow::onOverlayStyleChanged);
+    connect(ui->actionShowRegions, &QAction::toggled,
+            this, &MainWindow::onOverlayStyleChanged);
+    connect(ui->actionShowLatencyHud, &QAction::toggled,
+            this, [this]() { updateDisplayImage(); });
+    connect(ui->actionShowLatencyPanel, &QAction::toggled,
+            this, &MainWindow::onLatencyPanelToggled);
+    connect(ui->exportLatencyButton, &QPushButton::clicked,
+            this, &MainWindow::exportLatencyStats);
+    connect(ui->resetLatencyButton, &QPushButton::clicked,
+            this, [this]() {
+                mediaProcessor->latencyStats().reset();
+                onLatencyStatsChanged();
+                updateDisplayImage();
+            });
 
     // ========== 主题切换 ==========
     connect(ui->actionLightTheme, &QAction::triggered,
@@ -108,6 +153,8 @@ void MainWindow::setupConnections()
             this, &MainWindow::loadModel);
     connect(ui->actionSettings, &QAction::triggered,
             this, &MainWindow::showSettings);
+    connect(ui->actionComparePrecision, &QAction::triggered,
+            this, &MainWindow::comparePrecisions);
     connect(ui->actionAbout, &QAction::triggered,
             this, &MainWindow::showAbout);
 
@@ -118,30 +165,45 @@ void MainWindow::setupConnections()
             this, &MainWindow::pauseMedia);
     connect(ui->actionStop, &QAction::triggered,
             this, &MainWindow::stopMedia);
+    connect(ui->actionStepBackward, &QAction::triggered,
+            mediaProcessor, &MediaProcessor::stepBackward);
+    connect(ui->actionStepForward, &QAction::triggered,
+            mediaProcessor, &MediaProcessor::stepForward);
 
     // ========== 媒体处理器信号 ==========
+    // 视频播放时信号来自流水线的显示线程，统一使用排队连接，在界面线程中按发出顺序处理
+    connect(mediaProcessor, &MediaProcessor::detectionResults,
+            this, &MainWindow::onDetectionResults, Qt::QueuedConnection);
+
     connect(mediaProcessor, &MediaProcessor::frameReady,
-            this, &MainWindow::onFrameReady);
+            this, &MainWindow::onFrameReady, Qt::QueuedConnection);
 
     connect(mediaProcessor, &MediaProcessor::frameNumberChanged,
-            this, &MainWindow::onFrameNumberChanged);
+            this, &MainWindow::onFrameNumberChanged, Qt::QueuedConnection);
 
     connect(mediaProcessor, &MediaProcessor::fpsChanged,
-            this, &MainWindow::onFPSChanged);
+            this, &MainWindow::onFPSChanged, Qt::QueuedConnection);
 
     connect(mediaProcessor, &MediaProcessor::detectionCountChanged,
-            this, &MainWindow::onDetectionCountChanged);
-
-    connect(mediaProcessor, &MediaProcessor::detectionResults,
-            this, &MainWindow::onDetectionResults);
+            this, &MainWindow::onDetectionCountChanged, Qt::QueuedConnection);
 
     connect(mediaProcessor, &MediaProcessor::statusMessage,
             this, [this](const QString &msg) {
                 statusBar()->showMessage(msg);
-            });
-
+            }, Qt::QueuedConnection);
+
+    connect(mediaProcessor, &MediaProcessor::playbackStatsChanged,
+            this, &MainWindow::onPlaybackStatsChanged, Qt::QueuedConnection);
+    connect(mediaProcessor, &MediaProcessor::frameCacheStatsChanged,
+            this, &MainWindow::onFrameCacheStatsChanged, Qt::QueuedConnection);
+    connect(mediaProcessor, &MediaProcessor::latencyStatsChanged,
+            this, &MainWindow::onLatencyStatsChanged, Qt::QueuedConnection);
+    connect(mediaProcessor, &MediaProcessor::frameDecodedAt,
+            this, &MainWindow::onFrameDecodedAt, Qt::QueuedConnection);
+    connect(mediaProcessor, &MediaProcessor::skippedFramesChanged,
+            this, &MainWindow::onSkippedFramesChanged, Qt::QueuedConnection);
     connect(mediaProcessor, &MediaProcessor::mediaInfoChanged,
-            this, &MainWindow::onMediaInfoChanged);
+            this, &MainWindow::onMediaInfoChanged, Qt::QueuedConnection);
 
     // ========== 显示模式 ==========
     connect(displayModeGroup, SIGNAL(buttonClicked(int)),
@@ -154,11 +216,30 @@ void MainWindow::setupConnections()
     connect(ui->nmsSlider, &QSlider::valueChanged,
             this, &MainWindow::onNMSChanged);
 
+    connect(ui->tilingComboBox, SIGNAL(currentIndexChanged(int)),
+            this, SLOT(onTilingModeChanged(int)));
+    connect(ui->armorComboBox, SIGNAL(currentIndexChanged(int)),
+            this, SLOT(onArmorModeChanged(int)));
+    connect(ui->trackingCheckBox, &QCheckBox::toggled,
+            this, &MainWindow::onTrackingToggled);
+    connect(ui->fullDetectIntervalSpinBox, SIGNAL(valueChanged(int)),
+            this, SLOT(onFullDetectIntervalChanged(int)));
+    connect(ui->latePolicyComboBox, SIGNAL(currentIndexChanged(int)),
+            this, SLOT(onLatePolicyChanged(int)));
+    connect(ui->frameCacheSpinBox, SIGNAL(valueChanged(int)),
+            this, SLOT(onFrameCacheSizeChanged(int)));
+    connect(ui->motionGateCheckBox, &QCheckBox::toggled,
+            this, &MainWindow::onMotionGateToggled);
+    connect(ui->motionThresholdSpinBox, SIGNAL(valueChanged(double)),
+            this, SLOT(onMotionThresholdChanged(double)));
     connect(ui->roiSizeSpinBox, SIGNAL(valueChanged(int)),
             this, SLOT(onROISizeChanged(int)));
 
+    // 拖动时只预览关键帧，松开后精确定位
     connect(ui->progressSlider, &QSlider::sliderMoved,
             this, &MainWindow::onProgressSliderMoved);
+    connect(ui->progressSlider, &QSlider::sliderReleased,
+            this, &MainWindow::onProgressSliderReleased);
 }
 
 // 加载主题文件
@@ -218,6 +299,13 @@ void MainWindow::loadSettings()
     ui->leftPanel->setVisible(leftPanelVisible);
     ui->actionToggleLeftPanel->setChecked(leftPanelVisible);
 
+    // 恢复叠加层样式
+    ui->actionShowLabels->setChecked(settings.value("overlayLabels", true).toBool());
+    ui->actionShowKeypoints->setChecked(settings.value("overlayKeypoints", true).toBool());
+    ui->actionShowRegions->setChecked(settings.value("overlayRegions", true).toBool());
+    ui->actionShowLatencyHud->setChecked(settings.value("latencyHud", false).toBool());
+    ui->actionShowLatencyPanel->setChecked(settings.value("latencyPanel", false).toBool());
+
     // 恢复参数
     int confidence = settings.value("confidence", 50).toInt();
     int nms = settings.value("nms", 40).toInt();
@@ -226,6 +314,23 @@ void MainWindow::loadSettings()
     ui->confidenceSlider->setValue(confidence);
     ui->nmsSlider->setValue(nms);
     ui->roiSizeSpinBox->setValue(roiSize);
+    ui->fullDetectIntervalSpinBox->setValue(settings.value("fullDetectInterval", 10).toInt());
+    ui->tilingComboBox->setCurrentIndex(settings.value("tilingMode", 0).toInt());
+    ui->armorComboBox->setCurrentIndex(settings.value("armorMode", 0).toInt());
+    ui->trackingCheckBox->setChecked(settings.value("tracking", false).toBool());
+    ui->motionThresholdSpinBox->setValue(settings.value("motionThreshold", 2.0).toDouble());
+    ui->motionGateCheckBox->setChecked(settings.value("motionGate", false).toBool());
+    ui->latePolicyComboBox->setCurrentIndex(settings.value("latePolicy", 0).toInt());
+    ui->frameCacheSpinBox->setValue(settings.value("frameCacheMB", 256).toInt());
+
+    // 恢复检测器配置（在加载模型前生效）
+    rm_buff::DetectorConfig detectorConfig = mediaProcessor->getDetectorConfig();
+    detectorConfig.graph_preprocess = settings.value("graphPreprocess", false).toBool();
+    detectorConfig.try_gpu = settings.value("tryGpu", true).toBool();
+    detectorConfig.precision = static_cast<rm_buff::InferencePrecision>(
+        settings.value("precision", static_cast<int>(rm_buff::InferencePrecision::Default)).toInt());
+    detectorConfig.input_size = settings.value("inputSize", 640).toInt();
+    mediaProcessor->setDetectorConfig(detectorConfig);
 
     // 恢复主题
     QString theme = settings.value("theme", "light").toString();
@@ -257,10 +362,32 @@ void MainWindow::saveSettings()
     // 保存左侧面板
     settings.setValue("leftPanelVisible", ui->leftPanel->isVisible());
 
+    // 保存叠加层样式
+    settings.setValue("overlayLabels", overlayStyle_.showLabels);
+    settings.setValue("overlayKeypoints", overlayStyle_.showKeypoints);
+    settings.setValue("overlayRegions", overlayStyle_.showRegions);
+    settings.setValue("latencyHud", ui->actionShowLatencyHud->isChecked());
+    settings.setValue("latencyPanel", ui->actionShowLatencyPanel->isChecked());
+
     // 保存参数
     settings.setValue("confidence", ui->confidenceSlider->value());
     settings.setValue("nms", ui->nmsSlider->value());
     settings.setValue("roiSize", ui->roiSizeSpinBox->value());
+    settings.setValue("tilingMode", ui->tilingComboBox->currentIndex());
+    settings.setValue("armorMode", ui->armorComboBox->currentIndex());
+    settings.setValue("tracking", ui->trackingCheckBox->isChecked());
+    settings.setValue("fullDetectInterval", ui->fullDetectIntervalSpinBox->value());
+    settings.setValue("motionGate", ui->motionGateCheckBox->isChecked());
+    settings.setValue("motionThreshold", ui->motionThresholdSpinBox->value());
+    settings.setValue("latePolicy", ui->latePolicyComboBox->currentIndex());
+    settings.setValue("frameCacheMB", ui->frameCacheSpinBox->value());
+
+    // 保存检测器配置
+    const rm_buff::DetectorConfig& detectorConfig = mediaProcessor->getDetectorConfig();
+    settings.setValue("graphPreprocess", detectorConfig.graph_preprocess);
+    settings.setValue("tryGpu", detectorConfig.try_gpu);
+    settings.setValue("precision", static_cast<int>(detectorConfig.precision));
+    settings.setValue("inputSize", detectorConfig.input_size);
 
     // 保存主题
     settings.setValue("theme", currentTheme_);
@@ -274,10 +401,12 @@ void MainWindow::closeEvent(QCloseEvent *event)
     event->accept();
 }
 
-void MainWindow::resizeEvent(QResizeEvent *event)
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
 {
-    QMainWindow::resizeEvent(event);
-    updateDisplayImage();
+    if (watched == ui->displayLabel && event->type() == QEvent::Resize) {
+        updateDisplayImage();
+    }
+    return QMainWindow::eventFilter(watched, event);
 }
 
 // ========== 文件操作 ==========
@@ -318,7 +447,9 @@ void MainWindow::openVideo()
 
 void MainWindow::saveCurrentFrame()
 {
-    if (currentDisplayImage_.isNull()) {
+    // 界面上的图像已缩放到显示尺寸，保存时取原分辨率的处理结果
+    const QImage frame = mediaProcessor->getCurrentProcessedImage();
+    if (frame.isNull()) {
         QMessageBox::warning(this, tr("保存失败"), tr("当前没有可保存的图像"));
         return;
     }
@@ -335,7 +466,11 @@ void MainWindow::saveCurrentFrame()
 
     if (fileName.isEmpty()) return;
 
-    if (currentDisplayImage_.save(fileName)) {
+    // 检测叠加层按原图分辨率绘制到保存的图片上
+    const QImage image = currentOverlay_
+        ? DetectionOverlay::render(frame, *currentOverlay_, overlayStyle_)
+        : frame;
+    if (image.save(fileName)) {
         statusBar()->showMessage(tr("已保存: %1").arg(fileName), 3000);
     } else {
         QMessageBox::warning(this, tr("保存失败"), tr("无法保存图像"));
@@ -443,6 +578,15 @@ void MainWindow::actualSize()
     statusBar()->showMessage(tr("实际大小"), 2000);
 }
 
+void MainWindow::onOverlayStyleChanged()
+{
+    // 只重绘叠加层，不重新处理帧
+    overlayStyle_.showLabels = ui->actionShowLabels->isChecked();
+    overlayStyle_.showKeypoints = ui->actionShowKeypoints->isChecked();
+    overlayStyle_.showRegions = ui->actionShowRegions->isChecked();
+    updateDisplayImage();
+}
+
 // ========== 工具操作 ==========
 
 void MainWindow::loadModel()
@@ -461,12 +605,61 @@ void MainWindow::loadModel()
 
 void MainWindow::showSettings()
 {
-    QMessageBox::information(this, tr("设置"),
-        tr("参数设置功能开发中...\n"
-           "\n当前可通过左侧面板调整：\n"
-           "- 置信度阈值\n"
-           "- NMS 阈值\n"
-           "- ROI 大小"));
+    SettingsDialog dialog(mediaProcessor->getDetectorConfig(), this);
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    const rm_buff::DetectorConfig oldConfig = mediaProcessor->getDetectorConfig();
+    const rm_buff::DetectorConfig newConfig = dialog.config();
+    mediaProcessor->setDetectorConfig(newConfig);
+
+    // 影响编译的配置变化后重新加载模型
+    const bool changed = oldConfig.precision != newConfig.precision ||
+                         oldConfig.input_size != newConfig.input_size ||
+                         oldConfig.graph_preprocess != newConfig.graph_preprocess ||
+                         oldConfig.try_gpu != newConfig.try_gpu;
+    if (changed && mediaProcessor->hasDetectionModel()) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        const bool ok = mediaProcessor->reloadDetectionModel();
+        QApplication::restoreOverrideCursor();
+        if (!ok) {
+            // 新配置无法加载时恢复原配置，避免下次启动失败
+            mediaProcessor->setDetectorConfig(oldConfig);
+            QMessageBox::warning(this, tr("设置"), tr("无法按新配置加载模型，已保留原配置"));
+            return;
+        }
+        mediaProcessor->processCurrentImage();
+    }
+}
+
+void MainWindow::comparePrecisions()
+{
+    QStringList names;
+    const QList<rm_buff::InferencePrecision> precisions = {
+        rm_buff::InferencePrecision::FP32,
+        rm_buff::InferencePrecision::BF16,
+        rm_buff::InferencePrecision::FP16,
+        rm_buff::InferencePrecision::INT8,
+    };
+    for (rm_buff::InferencePrecision precision : precisions) {
+        names << rm_buff::precision_name(precision);
+    }
+
+    bool ok = false;
+    const QString referenceName = QInputDialog::getItem(
+        this, tr("精度对比"), tr("基准精度:"), names, 0, false, &ok);
+    if (!ok) return;
+    const QString candidateName = QInputDialog::getItem(
+        this, tr("精度对比"), tr("候选精度:"), names, names.size() - 1, false, &ok);
+    if (!ok) return;
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    statusBar()->showMessage(tr("正在对比精度..."));
+    const QString report = mediaProcessor->comparePrecisions(
+        precisions[names.indexOf(referenceName)], precisions[names.indexOf(candidateName)]);
+    QApplication::restoreOverrideCursor();
+    statusBar()->clearMessage();
+
+    QMessageBox::information(this, tr("精度对比"), report);
 }
 
 void MainWindow::showAbout()
@@ -498,46 +691,175 @@ void MainWindow::onFrameReady(const QImage &frame)
     if (!frame.isNull()) {
         currentDisplayImage_ = frame;
         updateDisplayImage();
+
+        // 帧龄：从解码完成到交给界面显示，包含推理、排队和缩放
+        if (pendingDecodedAtUs_ > 0) {
+            const qint64 nowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            mediaProcessor->latencyStats().record(LatencyStats::FrameAge,
+                                                  (nowUs - pendingDecodedAtUs_) / 1000.0);
+        }
     }
+    pendingDecodedAtUs_ = 0;
+}
+
+void MainWindow::onFrameDecodedAt(qint64 steadyUs)
+{
+    // 与紧接着的 frameReady 对应同一帧
+    pendingDecodedAtUs_ = steadyUs;
 }
 
 void MainWindow::updateDisplayImage()
 {
     if (currentDisplayImage_.isNull()) return;
 
-    QSize labelSize = ui->displayLabel->size();
-    QImage scaledImage;
+    LatencyStats& latency = mediaProcessor->latencyStats();
 
-    if (currentZoom_ == 1.0) {
-        // 适应窗口
-        scaledImage = currentDisplayImage_.scaled(
-            labelSize,
-            Qt::KeepAspectRatio,
-            Qt::SmoothTransformation
-        );
-    } else {
-        // 按缩放比例
-        QSize targetSize = currentDisplayImage_.size() * currentZoom_;
-        scaledImage = currentDisplayImage_.scaled(
-            targetSize,
-            Qt::KeepAspectRatio,
-            Qt::SmoothTransformation
-        );
+    // 目标尺寸按处理结果的原分辨率计算，显示线程送来的图像可能已经缩小
+    QSize sourceSize = mediaProcessor->getCurrentProcessedSize();
+    if (sourceSize.isEmpty()) {
+        sourceSize = currentDisplayImage_.size();
+    }
+    const QSize bounds = currentZoom_ == 1.0
+        ? ui->displayLabel->size()          // 适应窗口
+        : sourceSize * currentZoom_;        // 按缩放比例
+    const QSize targetSize = sourceSize.scaled(bounds, Qt::KeepAspectRatio);
+    if (targetSize.isEmpty()) return;
+
+    // 显示区域变化后由显示线程按新尺寸生成图像；暂停时重新生成当前帧，送到之前先在这里缩放
+    if (bounds != displayBounds_) {
+        displayBounds_ = bounds;
+        mediaProcessor->setDisplayBounds(bounds);
+        mediaProcessor->refreshDisplayImage();
+    }
+
+    // 同一帧且尺寸不变时复用位图，叠加层样式、HUD 或阈值变化只重绘叠加层
+    if (currentDisplayImage_.cacheKey() != basePixmapKey_ || basePixmap_.size() != targetSize) {
+        const auto scaleStart = LatencyStats::Clock::now();
+        const QImage scaledImage = currentDisplayImage_.size() == targetSize
+            ? currentDisplayImage_
+            : currentDisplayImage_.scaled(targetSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        basePixmap_ = QPixmap::fromImage(scaledImage);
+        basePixmapKey_ = currentDisplayImage_.cacheKey();
+        latency.record(LatencyStats::Scale, scaleStart, LatencyStats::Clock::now());
     }
 
-    ui->displayLabel->setPixmap(QPixmap::fromImage(scaledImage));
+    // 检测叠加层在缩放后的图像上绘制，线条和文字保持显示分辨率下的清晰度
+    QPixmap pixmap = basePixmap_;
+    const bool showOverlay = currentOverlay_ && !currentOverlay_->isEmpty();
+    const bool showHud = ui->actionShowLatencyHud->isChecked() && !latencyLines_.isEmpty();
+    if (showOverlay || showHud) {
+        QPainter painter(&pixmap);
+        if (showOverlay) {
+            const auto drawStart = LatencyStats::Clock::now();
+            DetectionOverlay::paint(painter, *currentOverlay_,
+                                    static_cast<qreal>(targetSize.width()) / sourceSize.width(),
+                                    overlayStyle_);
+            latency.record(LatencyStats::Draw, drawStart, LatencyStats::Clock::now());
+        }
+        if (showHud) {
+            DetectionOverlay::paintHud(painter, latencyLines_);
+        }
+    }
+    ui->displayLabel->setPixmap(pixmap);
 }
 
 void MainWindow::onFrameNumberChanged(int current, int total)
 {
     ui->frameLabel->setText(tr("帧：%1/%2").arg(current).arg(total));
     ui->progressSlider->setMaximum(total);
-    ui->progressSlider->setValue(current);
+    // 拖动中不跟随预览帧，避免滑块跳到关键帧位置
+    if (!ui->progressSlider->isSliderDown()) {
+        ui->progressSlider->setValue(current);
+    }
 }
 
 void MainWindow::onFPSChanged(double fps)
 {
-    ui->fpsLabel->setText(tr("FPS：%1").arg(static_cast<int>(fps)));
+    // 实测推理帧率
+    ui->fpsLabel->setText(tr("FPS：%1").arg(fps, 0, 'f', 1));
+}
+
+void MainWindow::onPlaybackStatsChanged(double lagMs, int dropped, int skipped)
+{
+    QString text = tr("延迟：%1 ms").arg(static_cast<int>(lagMs));
+    if (dropped > 0) {
+        text += tr("  丢帧：%1").arg(dropped);
+    }
+    if (skipped > 0) {
+        text += tr("  未推理：%1").arg(skipped);
+    }
+    ui->lagLabel->setText(text);
+}
+
+void MainWindow::onFrameCacheStatsChanged(int hits, int misses, double usedMB)
+{
+    ui->cacheLabel->setText(tr("缓存：%1/%2  %3 MB")
+                                .arg(hits).arg(hits + misses)
+                                .arg(usedMB, 0, 'f', 0));
+}
+
+void MainWindow::onLatencyStatsChanged()
+{
+    // HUD 和面板共用同一份文本，按统计信号的节奏刷新，数字不会随每帧跳动
+    latencyLines_.clear();
+    LatencyStats& stats = mediaProcessor->latencyStats();
+    for (int i = 0; i < LatencyStats::StageCount; ++i) {
+        const LatencyStats::Stage stage = static_cast<LatencyStats::Stage>(i);
+        const LatencyStats::Summary summary = stats.summary(stage);
+        if (summary.count == 0) {
+            continue;
+        }
+        latencyLines_ << QString("%1%2%3%4")
+                             .arg(QString::fromLatin1(LatencyStats::stageName(stage)), -12)
+                             .arg(summary.p50, 8, 'f', 2)
+                             .arg(summary.p95, 8, 'f', 2)
+                             .arg(summary.p99, 8, 'f', 2);
+    }
+    if (!latencyLines_.isEmpty()) {
+        latencyLines_.prepend(QString("%1%2%3%4").arg("ms", -12)
+                                  .arg("p50", 8).arg("p95", 8).arg("p99", 8));
+    }
+
+    if (ui->actionShowLatencyPanel->isChecked()) {
+        ui->latencyStatsLabel->setText(latencyLines_.isEmpty() ? tr("暂无数据")
+                                                               : latencyLines_.join('\n'));
+    }
+}
+
+void MainWindow::onLatencyPanelToggled(bool visible)
+{
+    ui->latencyGroup->setVisible(visible);
+    if (visible) {
+        onLatencyStatsChanged();
+    }
+}
+
+void MainWindow::exportLatencyStats()
+{
+    QString defaultPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)
+                         + "/latency_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".csv";
+
+    QString fileName = QFileDialog::getSaveFileName(
+        this,
+        tr("导出阶段耗时"),
+        defaultPath,
+        tr("CSV 文件 (*.csv);;所有文件 (*.*)")
+    );
+
+    if (fileName.isEmpty()) return;
+
+    QString error;
+    if (!mediaProcessor->latencyStats().writeCsv(fileName, &error)) {
+        QMessageBox::warning(this, tr("导出失败"), tr("无法写入文件: %1").arg(error));
+        return;
+    }
+    statusBar()->showMessage(tr("已导出: %1").arg(fileName), 3000);
+}
+
+void MainWindow::onSkippedFramesChanged(int skipped, int total)
+{
+    ui->skippedLabel->setText(tr("跳过：%1/%2 帧").arg(skipped).arg(total));
 }
 
 void MainWindow::onDetectionCountChanged(int count)
@@ -545,15 +867,20 @@ void MainWindow::onDetectionCountChanged(int count)
     ui->detectionCountLabel->setText(tr("检测：%1 个目标").arg(count));
 }
 
-void MainWindow::onDetectionResults(const QList<QVariantMap> &results)
+void MainWindow::onDetectionResults(const DetectionResultPtr &result)
 {
+    // 叠加层随下一次 frameReady 绘制
+    currentOverlay_ = result;
+    if (!result || !result->detected) {
+        return;
+    }
+
     ui->detectionList->clear();
 
-    for (int i = 0; i < results.size(); ++i) {
-        QVariantMap det = results[i];
+    for (const rm_buff::Blade& blade : result->blades) {
         QString text = tr("%1 - 置信度: %2%")
-            .arg(det["label"].toString())
-            .arg(static_cast<int>(det["confidence"].toDouble() * 100));
+            .arg(QLatin1String(rm_buff::class_name(blade.cls)))
+            .arg(static_cast<int>(blade.prob * 100));
 
         QListWidgetItem *item = new QListWidgetItem(text);
         item->setCheckState(Qt::Checked);
@@ -594,9 +921,58 @@ void MainWindow::onROISizeChanged(int value)
     mediaProcessor->setROISize(value, value);
 }
 
+void MainWindow::onTilingModeChanged(int index)
+{
+    mediaProcessor->setTilingMode(static_cast<MediaProcessor::TilingMode>(index));
+}
+
+void MainWindow::onArmorModeChanged(int index)
+{
+    mediaProcessor->setArmorMode(static_cast<MediaProcessor::ArmorMode>(index));
+}
+
+void MainWindow::onTrackingToggled(bool checked)
+{
+    mediaProcessor->setTrackingEnabled(checked);
+    ui->fullDetectIntervalSpinBox->setEnabled(checked);
+}
+
+void MainWindow::onFullDetectIntervalChanged(int value)
+{
+    mediaProcessor->setFullDetectInterval(value);
+}
+
+void MainWindow::onLatePolicyChanged(int index)
+{
+    mediaProcessor->setLatePolicy(static_cast<VideoPipeline::LatePolicy>(index));
+}
+
+void MainWindow::onFrameCacheSizeChanged(int megabytes)
+{
+    mediaProcessor->setFrameCacheSize(megabytes);
+}
+
+void MainWindow::onMotionGateToggled(bool checked)
+{
+    mediaProcessor->setMotionGateEnabled(checked);
+    ui->motionThresholdSpinBox->setEnabled(checked);
+    ui->skippedLabel->setVisible(checked &&
+        mediaProcessor->getMediaType() == MediaProcessor::VideoType);
+}
+
+void MainWindow::onMotionThresholdChanged(double value)
+{
+    mediaProcessor->setMotionThreshold(value);
+}
+
 void MainWindow::onProgressSliderMoved(int value)
 {
-    mediaProcessor->seekToFrame(value);
+    mediaProcessor->previewFrame(value);
+}
+
+void MainWindow::onProgressSliderReleased()
+{
+    mediaProcessor->seekToFrame(ui->progressSlider->value());
 }
 
 void MainWindow::updateUIForMediaType(MediaProcessor::MediaType type)
@@ -607,7 +983,12 @@ void MainWindow::updateUIForMediaType(MediaProcessor::MediaType type)
     ui->actionPlay->setVisible(isVideo);
     ui->actionPause->setVisible(isVideo);
     ui->actionStop->setVisible(isVideo);
+    ui->actionStepBackward->setVisible(isVideo);
+    ui->actionStepForward->setVisible(isVideo);
     ui->progressSlider->setVisible(isVideo);
     ui->frameLabel->setVisible(isVideo);
     ui->fpsLabel->setVisible(isVideo);
+    ui->lagLabel->setVisible(isVideo);
+    ui->cacheLabel->setVisible(isVideo);
+    ui->skippedLabel->setVisible(isVideo && ui->motionGateCheckBox->isChecked());
 }
@@ -5,23 +5,45 @@
 #include <QCoreApplication>
 #include <QStandardPaths>
 #include <QDateTime>
+#include <QCryptographicHash>
+
+namespace
+{
+// 单步前进后向后预取的帧数
+const int kPrefetchFrames = 8;
+// 后退未命中时连同目标帧一起解码进缓存的帧数
+const int kBackwardCacheFrames = 16;
+// 停止 / 暂停时检测器保留 NMS 前候选的置信度下限，阈值不低于它时调整阈值无需重新推理
+const float kCandidateFloor = 0.05f;
+} // namespace
 
 MediaProcessor::MediaProcessor(QObject *parent)
     : QObject(parent)
     , mediaType_(NoMedia)
-    , displayMode_(OriginalMode)
-    , confidenceThreshold_(0.5)
-    , nmsThreshold_(0.4)
-    , roiWidth_(640)
-    , roiHeight_(480)
+    , paramsVersion_(0)
+    , activeVersion_(-1)
     , playbackSpeed_(1.0)
     , totalFrames_(0)
     , currentFrame_(0)
+    , decodedFrame_(0)
     , fps_(0)
     , isPlaying_(false)
+    , pipeline_(4)
+    , emptyResult_(std::make_shared<DetectionResult>())
+    , indexCancel_(false)
+    , previewKeyframe_(-1)
+    , resumeAfterSeek_(false)
+    , frameCache_(256u << 20)
+    , prefetchUntil_(-1)
+    , prefetchQueued_(false)
+    , candidatesFrame_(-1)
+    , candidatesArmor_(false)
+    , core_(std::make_shared<ov::Core>())
+    , skippedFrames_(0)
+    , gatedFrames_(0)
 {
-    timer_ = new QTimer(this);
-    connect(timer_, &QTimer::timeout, this, &MediaProcessor::processNextFrame);
+    // 检测结果通过排队连接跨线程传递
+    qRegisterMetaType<DetectionResultPtr>("DetectionResultPtr");
 }
 
 MediaProcessor::~MediaProcessor()
@@ -29,105 +51,357 @@ MediaProcessor::~MediaProcessor()
     closeMedia();
 }
 
-bool MediaProcessor::loadDetectionModel(const QString& modelPath)
+bool MediaProcessor::resolveModelFiles(const QString& modelPath, const QString& baseName,
+                                       QString& actualXmlPath, QString* error)
 {
-    try {
-        QString actualXmlPath;
-        QString actualBinPath;
-
-        // Lambda: 提取文件到可写路径
-        auto extractFile = [](const QString& src, const QString& dst) -> bool {
-            if (QFile::exists(dst)) QFile::remove(dst);
-            QFile fileSrc(src);
-            if (!fileSrc.open(QIODevice::ReadOnly)) return false;
-            QFile fileDst(dst);
-            if (!fileDst.open(QIODevice::WriteOnly)) return false;
-            fileDst.write(fileSrc.readAll());
-            fileDst.close();
-            fileSrc.close();
-            QFile::setPermissions(dst,
-                QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
-            return true;
-        };
-
-        // 判断是否是资源路径 (AppImage 内部)
-        if (modelPath.startsWith(":/") || modelPath.startsWith("qrc:/")) {
-            // 尝试多个可写目录
-            QString modelDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/model";
+    QString actualBinPath;
+
+    // Lambda: 提取文件到可写路径
+    auto extractFile = [](const QString& src, const QString& dst) -> bool {
+        if (QFile::exists(dst)) QFile::remove(dst);
+        QFile fileSrc(src);
+        if (!fileSrc.open(QIODevice::ReadOnly)) return false;
+        QFile fileDst(dst);
+        if (!fileDst.open(QIODevice::WriteOnly)) return false;
+        fileDst.write(fileSrc.readAll());
+        fileDst.close();
+        fileSrc.close();
+        QFile::setPermissions(dst,
+            QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+        return true;
+    };
+
+    // 判断是否是资源路径 (AppImage 内部)
+    if (modelPath.startsWith(":/") || modelPath.startsWith("qrc:/")) {
+        // 尝试多个可写目录
+        QString modelDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/model";
+        if (!QDir().mkpath(modelDir)) {
+            modelDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/model";
             if (!QDir().mkpath(modelDir)) {
-                modelDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/model";
+                modelDir = QDir::tempPath() + "/VideoDetection/model";
                 if (!QDir().mkpath(modelDir)) {
-                    modelDir = QDir::tempPath() + "/VideoDetection/model";
-                    if (!QDir().mkpath(modelDir)) {
-                        qDebug() << "无法创建可写模型目录";
-                        emit statusMessage(tr("无法创建模型目录"));
-                        return false;
-                    }
+                    qDebug() << "无法创建可写模型目录";
+                    if (error) *error = tr("无法创建模型目录");
+                    return false;
                 }
             }
+        }
 
-            // 构建目标文件路径
-            actualXmlPath = modelDir + "/buff_model.xml";
-            actualBinPath = modelDir + "/buff_model.bin";
+        // 构建目标文件路径
+        actualXmlPath = modelDir + "/" + baseName + ".xml";
+        actualBinPath = modelDir + "/" + baseName + ".bin";
 
-            QString xmlRes = modelPath;
-            QString binRes = modelPath;
-            binRes.replace(".xml", ".bin");
+        QString xmlRes = modelPath;
+        QString binRes = modelPath;
+        binRes.replace(".xml", ".bin");
 
-            qDebug() << "准备提取模型到:" << modelDir;
-            qDebug() << "XML 资源:" << xmlRes << "BIN 资源:" << binRes;
+        qDebug() << "准备提取模型到:" << modelDir;
+        qDebug() << "XML 资源:" << xmlRes << "BIN 资源:" << binRes;
 
-            if (!extractFile(xmlRes, actualXmlPath)) {
-                emit statusMessage(tr("无法写入模型文件 .xml"));
-                return false;
-            }
-            if (!extractFile(binRes, actualBinPath)) {
-                emit statusMessage(tr("无法写入模型文件 .bin"));
-                return false;
-            }
+        if (!extractFile(xmlRes, actualXmlPath)) {
+            if (error) *error = tr("无法写入模型文件 .xml");
+            return false;
+        }
+        if (!extractFile(binRes, actualBinPath)) {
+            if (error) *error = tr("无法写入模型文件 .bin");
+            return false;
+        }
 
-            qDebug() << "模型提取完成";
-            qDebug() << "XML 大小:" << QFileInfo(actualXmlPath).size();
-            qDebug() << "BIN 大小:" << QFileInfo(actualBinPath).size();
+        // INT8 量化模型随资源打包时一并提取（可选）
+        QString int8XmlRes = xmlRes;
+        int8XmlRes.replace(".xml", "_int8.xml");
+        QString int8BinRes = int8XmlRes;
+        int8BinRes.replace(".xml", ".bin");
+        if (QFile::exists(int8XmlRes) && QFile::exists(int8BinRes)) {
+            extractFile(int8XmlRes, modelDir + "/" + baseName + "_int8.xml");
+            extractFile(int8BinRes, modelDir + "/" + baseName + "_int8.bin");
+        }
 
-        } else {
-            // 外部路径，直接使用
-            actualXmlPath = modelPath;
-            actualBinPath = modelPath;
-            actualBinPath.replace(".xml", ".bin");
+        qDebug() << "模型提取完成";
+        qDebug() << "XML 大小:" << QFileInfo(actualXmlPath).size();
+        qDebug() << "BIN 大小:" << QFileInfo(actualBinPath).size();
 
-            qDebug() << "使用外部模型路径:" << actualXmlPath;
-        }
+    } else {
+        // 外部路径，直接使用
+        actualXmlPath = modelPath;
+        actualBinPath = modelPath;
+        actualBinPath.replace(".xml", ".bin");
 
-        // 验证文件存在
-        if (!QFile::exists(actualXmlPath)) {
-            qDebug() << "XML 文件不存在:" << actualXmlPath;
-            emit statusMessage(tr("模型文件不存在: %1").arg(actualXmlPath));
-            return false;
+        qDebug() << "使用外部模型路径:" << actualXmlPath;
+    }
+
+    // 验证文件存在
+    if (!QFile::exists(actualXmlPath)) {
+        qDebug() << "XML 文件不存在:" << actualXmlPath;
+        if (error) *error = tr("模型文件不存在: %1").arg(actualXmlPath);
+        return false;
+    }
+    if (!QFile::exists(actualBinPath)) {
+        qDebug() << "BIN 文件不存在:" << actualBinPath;
+        if (error) *error = tr("模型权重文件不存在: %1").arg(actualBinPath);
+        return false;
+    }
+    return true;
+}
+
+rm_buff::DetectorConfig MediaProcessor::makeDetectorConfig(rm_buff::ModelType type) const
+{
+    // 编译模型缓存目录，第二次启动起直接导入已编译模型
+    rm_buff::DetectorConfig config = detectorConfig_;
+    config.model_type = type;
+    if (config.cache_dir.empty()) {
+        QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/model_cache";
+        if (QDir().mkpath(cacheDir)) {
+            config.cache_dir = cacheDir.toStdString();
+        } else {
+            qDebug() << "无法创建模型缓存目录:" << cacheDir;
         }
-        if (!QFile::exists(actualBinPath)) {
-            qDebug() << "BIN 文件不存在:" << actualBinPath;
-            emit statusMessage(tr("模型权重文件不存在: %1").arg(actualBinPath));
+    }
+    return config;
+}
+
+void MediaProcessor::rebuildDetectorGroup()
+{
+    // 能量机关和装甲板检测器组成一组，在同一帧上同时推理，输入一致时共享预处理
+    group_.clear();
+    if (detector_) {
+        group_.add(detector_.get());
+    }
+    if (armorDetector_) {
+        group_.add(armorDetector_.get());
+    }
+}
+
+bool MediaProcessor::loadDetectionModel(const QString& modelPath)
+{
+    // 替换检测器前先停下流水线，加载完成后继续播放
+    const bool resume = pipeline_.isRunning();
+    stopPipeline();
+    const bool ok = createDetector(modelPath);
+    if (resume) {
+        startPipeline();
+    }
+    return ok;
+}
+
+bool MediaProcessor::createDetector(const QString& modelPath)
+{
+    try {
+        QString actualXmlPath;
+        QString error;
+        if (!resolveModelFiles(modelPath, "buff_model", actualXmlPath, &error)) {
+            emit statusMessage(error);
             return false;
         }
 
-        // 加载 OpenVINO 模型
+        rm_buff::DetectorConfig config = makeDetectorConfig(rm_buff::ModelType::Buff);
+
+        // 加载 OpenVINO 模型，旧检测器销毁前先从检测组中移除
         qDebug() << "开始加载 OpenVINO 模型:" << actualXmlPath;
-        detector_ = std::make_unique<rm_buff::Detector>(actualXmlPath.toStdString());
-        detector_->setConfThreshold(confidenceThreshold_);
-        detector_->setNMSThreshold(nmsThreshold_);
-        qDebug() << "模型加载成功";
-        emit statusMessage(tr("模型加载成功: %1").arg(actualXmlPath));
+        group_.clear();
+        detector_ = std::make_unique<rm_buff::Detector>(actualXmlPath.toStdString(), config, core_);
+        candidatesFrame_ = -1;
+        modelPath_ = modelPath;
+        actualModelPath_ = actualXmlPath;
+        rebuildDetectorGroup();
+        updateCandidateFloor(pipeline_.isRunning());
+
+        // 分块和跟踪裁剪的尺寸跟随网络输入，分块内不再缩放
+        const int inputSize = detector_->getInputSize();
+        rm_buff::TileConfig tileConfig = tiledDetector_.getConfig();
+        tileConfig.tile_size = inputSize;
+        tileConfig.overlap = inputSize / 5;
+        tiledDetector_.setConfig(tileConfig);
+        rm_buff::TrackerConfig trackerConfig = tracker_.getConfig();
+        trackerConfig.min_crop_size = inputSize;
+        tracker_.setConfig(trackerConfig);
+        tracker_.reset();
+        motionGate_.reset();
+        lastResult_.reset();
+        applyDetectorThresholds();
+        // 换模型后帧缓存中的处理结果不再可用
+        publishParams(params_);
+        qDebug() << "模型加载成功，设备:" << QString::fromStdString(detector_->getDevice())
+                 << "精度:" << rm_buff::precision_name(config.precision)
+                 << "输入:" << inputSize;
+        emit statusMessage(tr("模型加载成功: %1").arg(
+            QString::fromStdString(detector_->getModelPath())));
 
         return true;
 
     } catch (const std::exception& e) {
+        rebuildDetectorGroup();
         qDebug() << "模型加载异常:" << e.what();
         emit statusMessage(tr("模型加载失败: %1").arg(e.what()));
         return false;
     }
 }
 
+bool MediaProcessor::loadArmorModel(const QString& modelPath)
+{
+    const bool resume = pipeline_.isRunning();
+    stopPipeline();
+    const bool ok = createArmorDetector(modelPath);
+    if (resume) {
+        startPipeline();
+    }
+    return ok;
+}
+
+bool MediaProcessor::createArmorDetector(const QString& modelPath)
+{
+    try {
+        QString actualXmlPath;
+        QString error;
+        if (!resolveModelFiles(modelPath, "armor_model", actualXmlPath, &error)) {
+            emit statusMessage(error);
+            return false;
+        }
+
+        // 装甲板模型与能量机关模型使用相同的输入尺寸和预处理，才能共享输入张量
+        rm_buff::DetectorConfig config = makeDetectorConfig(rm_buff::ModelType::Armor);
+        if (config.precision == rm_buff::InferencePrecision::INT8 &&
+            !QFile::exists(QString::fromStdString(rm_buff::Detector::modelPathFor(
+                actualXmlPath.toStdString(), config.precision)))) {
+            // 没有量化的装甲板模型时使用原模型
+            config.precision = rm_buff::InferencePrecision::Default;
+        }
+
+        qDebug() << "开始加载装甲板模型:" << actualXmlPath;
+        group_.clear();
+        armorDetector_ = std::make_unique<rm_buff::Detector>(actualXmlPath.toStdString(), config, core_);
+        candidatesFrame_ = -1;
+        armorModelPath_ = modelPath;
+        rebuildDetectorGroup();
+        updateCandidateFloor(pipeline_.isRunning());
+
+        applyDetectorThresholds();
+        motionGate_.reset();
+        lastResult_.reset();
+        publishParams(params_);
+        qDebug() << "装甲板模型加载成功，设备:" << QString::fromStdString(armorDetector_->getDevice())
+                 << "共享输入:" << (detector_ && armorDetector_->CanShareInput(*detector_));
+        return true;
+
+    } catch (const std::exception& e) {
+        armorDetector_.reset();
+        rebuildDetectorGroup();
+        qDebug() << "装甲板模型加载异常:" << e.what();
+        emit statusMessage(tr("装甲板模型加载失败: %1").arg(e.what()));
+        return false;
+    }
+}
+
+void MediaProcessor::setArmorMode(ArmorMode mode)
+{
+    if (params_.armorMode == mode) {
+        return;
+    }
+    ProcessingParams params = params_;
+    params.armorMode = mode;
+    publishParams(params);
+
+    if (mediaType_ == ImageType && params_.displayMode == DetectionMode) {
+        processCurrentImage();
+    }
+}
+
+void MediaProcessor::applyDetectorThresholds()
+{
+    // 检测器只在处理线程中使用；加载模型时流水线已停止，按已发布的参数设置
+    const ProcessingParams& params = pipeline_.isRunning() ? active_ : params_;
+    if (detector_) {
+        detector_->setConfThreshold(params.confidence);
+        detector_->setNMSThreshold(params.nms);
+    }
+    if (armorDetector_) {
+        armorDetector_->setConfThreshold(params.confidence);
+        armorDetector_->setNMSThreshold(params.nms);
+    }
+}
+
+bool MediaProcessor::reloadDetectionModel()
+{
+    if (modelPath_.isEmpty()) {
+        return false;
+    }
+
+    const bool resume = pipeline_.isRunning();
+    stopPipeline();
+    bool ok = createDetector(modelPath_);
+    // 装甲板模型跟随新的输入尺寸和精度重新加载，保持与能量机关模型共享输入
+    if (ok && !armorModelPath_.isEmpty()) {
+        createArmorDetector(armorModelPath_);
+    }
+    if (resume) {
+        startPipeline();
+    }
+    return ok;
+}
+
+void MediaProcessor::setInferencePrecision(rm_buff::InferencePrecision precision)
+{
+    if (detectorConfig_.precision == precision) {
+        return;
+    }
+    detectorConfig_.precision = precision;
+
+    // 已加载模型时立即按新精度重新编译
+    if (detector_) {
+        reloadDetectionModel();
+        processCurrentImage();
+    }
+}
+
+void MediaProcessor::setInputSize(int size)
+{
+    // 向下取整到 32 的倍数
+    size = std::max(32, size / 32 * 32);
+    if (detectorConfig_.input_size == size) {
+        return;
+    }
+    detectorConfig_.input_size = size;
+
+    if (detector_) {
+        reloadDetectionModel();
+        processCurrentImage();
+    }
+}
+
+QString MediaProcessor::comparePrecisions(rm_buff::InferencePrecision reference,
+                                          rm_buff::InferencePrecision candidate,
+                                          int maxFrames)
+{
+    if (actualModelPath_.isEmpty()) {
+        return tr("尚未加载模型");
+    }
+
+    // 图片直接使用当前图像；视频从独立的 VideoCapture 均匀抽帧，不影响播放位置
+    std::vector<cv::Mat> frames;
+    if (mediaType_ == ImageType && !currentImage_.empty()) {
+        frames.push_back(currentImage_);
+    } else if (mediaType_ == VideoType) {
+        cv::VideoCapture capture(currentFilePath_.toStdString());
+        const int step = std::max(1, totalFrames_ / std::max(1, maxFrames));
+        cv::Mat frame;
+        for (int i = 0; i < maxFrames && capture.isOpened(); ++i) {
+            capture.set(cv::CAP_PROP_POS_FRAMES, i * step);
+            if (!capture.read(frame) || frame.empty()) break;
+            frames.push_back(frame.clone());
+        }
+    }
+    if (frames.empty()) {
+        return tr("请先打开图片或视频");
+    }
+
+    try {
+        rm_buff::PrecisionReport report = rm_buff::compare_precisions(
+            actualModelPath_.toStdString(), detectorConfig_, reference, candidate, frames);
+        return QString::fromStdString(rm_buff::format_precision_report(report));
+    } catch (const std::exception& e) {
+        return tr("精度对比失败: %1").arg(e.what());
+    }
+}
 
 bool MediaProcessor::loadImage(const QString& filePath)
 {
@@ -184,16 +458,19 @@ bool MediaProcessor::loadVideo(const QString& filePath)
     currentFrame_ = 0;
 
     emit frameNumberChanged(0, totalFrames_);
-    emit fpsChanged(fps_);
+    emit fpsChanged(0.0);
+    emit playbackStatsChanged(0.0, 0, 0);
 
     QFileInfo fileInfo(filePath);
     QString info = QString("%1 帧, %2 FPS")
-                      .arg(totalFrames_)
+                      .arg(totalFrames_.load())
                       .arg(static_cast<int>(fps_));
 
     emit mediaInfoChanged("视频", mediaSize_, info);
     emit statusMessage(tr("已加载视频: %1").arg(fileInfo.fileName()));
 
+    decodedFrame_ = 0;
+    openKeyframeIndex(filePath);
     processNextFrame();
 
     return true;
@@ -202,14 +479,27 @@ bool MediaProcessor::loadVideo(const QString& filePath)
 void MediaProcessor::closeMedia()
 {
     stop();
+    cancelKeyframeIndex();
+    keyframeIndex_.reset();
+    previewKeyframe_ = -1;
+    prefetchUntil_ = -1;
+    frameCache_.clear();
+    frameCache_.resetStats();
+    candidatesFrame_ = -1;
+    latency_.reset();
 
     if (videoCapture_.isOpened()) {
         videoCapture_.release();
     }
 
     currentImage_ = cv::Mat();
+    lastFrame_.release();
     mediaType_ = NoMedia;
     currentFilePath_.clear();
+    tracker_.reset();
+    tiledDetector_.reset();
+    lastResult_.reset();
+    resetMotionStats();
 }
 
 void MediaProcessor::play()
@@ -218,50 +508,501 @@ void MediaProcessor::play()
         emit statusMessage(tr("没有加载视频"));
         return;
     }
+    if (isPlaying_) {
+        return;
+    }
 
     isPlaying_ = true;
-    int interval = static_cast<int>(1000.0 / (fps_ * playbackSpeed_));
-    timer_->start(interval);
+    startPipeline();
     emit statusMessage(tr("播放中..."));
 }
 
 void MediaProcessor::pause()
 {
     isPlaying_ = false;
-    timer_->stop();
+    resumeAfterSeek_ = false;
+    stopPipeline();
     emit statusMessage(tr("已暂停"));
 }
 
 void MediaProcessor::stop()
 {
     isPlaying_ = false;
-    timer_->stop();
+    resumeAfterSeek_ = false;
+    previewKeyframe_ = -1;
+    stopPipeline();
 
     if (mediaType_ == VideoType && videoCapture_.isOpened()) {
-        videoCapture_.set(cv::CAP_PROP_POS_FRAMES, 0);
+        seekCapture(0);
         currentFrame_ = 0;
+        tracker_.reset();
+        tiledDetector_.reset();
+        motionGate_.reset();
         processNextFrame();
     }
 
     emit statusMessage(tr("已停止"));
 }
 
+void MediaProcessor::onPlaybackFinished()
+{
+    stop();
+    emit statusMessage(tr("视频播放完毕"));
+}
+
+double MediaProcessor::frameDurationMs() const
+{
+    return fps_ > 0 ? 1000.0 / fps_ : 40.0;
+}
+
+void MediaProcessor::startPipeline()
+{
+    if (mediaType_ != VideoType || !videoCapture_.isOpened() || pipeline_.isRunning()) {
+        return;
+    }
+
+    prefetchUntil_ = -1;
+    if (decodedFrame_ != currentFrame_) {
+        seekCapture(currentFrame_);
+    }
+    // 帧缓存只服务暂停时的单步和拖动，播放期间不再持有这些帧和检测结果
+    frameCache_.clear();
+    emitFrameCacheStats();
+    updateCandidateFloor(true);
+    lastStatsEmit_ = std::chrono::steady_clock::now();
+    pipeline_.setPlaybackRate(playbackSpeed_);
+    pipeline_.setLateTolerance(frameDurationMs());
+    pipeline_.start(
+        // 解码线程
+        [this](FramePacket& packet) {
+            if (!decodeFrame(packet.frame, &packet.decodedAt)) {
+                return false;
+            }
+            // 帧号自行计数，不依赖定位后 CAP_PROP_POS_FRAMES 的估算
+            packet.index = ++decodedFrame_;
+            // 容器不提供时间戳时按帧号和标称帧率推算
+            packet.timestampMs = videoCapture_.get(cv::CAP_PROP_POS_MSEC);
+            if (packet.timestampMs <= 0 && packet.index > 1) {
+                packet.timestampMs = (packet.index - 1) * frameDurationMs();
+            }
+            return true;
+        },
+        // 推理线程
+        [this](FramePacket& packet) {
+            processFrame(packet.frame, packet);
+        },
+        // 推理线程：迟到帧
+        [this](FramePacket& packet) {
+            passThroughFrame(packet.frame, packet);
+        },
+        // 显示线程
+        [this](FramePacket& packet) {
+            presentFrame(packet);
+            emitPlaybackStats();
+        },
+        // 视频结束：回到界面线程停止流水线
+        [this]() {
+            QMetaObject::invokeMethod(this, "onPlaybackFinished", Qt::QueuedConnection);
+        });
+}
+
+void MediaProcessor::setLatePolicy(VideoPipeline::LatePolicy policy)
+{
+    pipeline_.setLatePolicy(policy);
+}
+
+void MediaProcessor::passThroughFrame(const cv::Mat& frame, FramePacket& packet)
+{
+    syncParams();
+    if (active_.displayMode != DetectionMode) {
+        processFrame(frame, packet);
+        return;
+    }
+    packet.processed = frame;
+    packet.result = lastResult_ ? lastResult_ : emptyResult_;
+    packet.skippedFrames = -1;
+    packet.paramsVersion = -1;
+}
+
+void MediaProcessor::emitPlaybackStats()
+{
+    // 每半秒发出一次，避免界面被统计信号淹没
+    const auto now = std::chrono::steady_clock::now();
+    if (now - lastStatsEmit_ < std::chrono::milliseconds(500)) {
+        return;
+    }
+    lastStatsEmit_ = now;
+
+    const VideoPipeline::Stats stats = pipeline_.stats();
+    emit fpsChanged(stats.processFps);
+    emit playbackStatsChanged(stats.lagMs, stats.dropped, stats.skipped);
+    emitFrameCacheStats();
+    emit latencyStatsChanged();
+}
+
+void MediaProcessor::emitFrameCacheStats()
+{
+    const FrameCache::Stats stats = frameCache_.stats();
+    emit frameCacheStatsChanged(static_cast<int>(stats.hits), static_cast<int>(stats.misses),
+                                stats.bytes / (1024.0 * 1024.0));
+}
+
+void MediaProcessor::stopPipeline()
+{
+    if (!pipeline_.isRunning()) {
+        return;
+    }
+    pipeline_.stop();
+    updateCandidateFloor(false);
+
+    // 已解码但未显示的帧被丢弃，解码位置退回到最后显示的帧之后
+    if (decodedFrame_ != currentFrame_) {
+        seekCapture(currentFrame_);
+        tracker_.reset();
+        tiledDetector_.reset();
+        motionGate_.reset();
+    }
+}
+
 void MediaProcessor::seekToFrame(int frameNumber)
 {
     if (mediaType_ != VideoType || !videoCapture_.isOpened()) return;
 
+    const bool resume = pipeline_.isRunning() || resumeAfterSeek_;
+    resumeAfterSeek_ = false;
+    previewKeyframe_ = -1;
+    prefetchUntil_ = -1;
+    // 马上要重新定位，不必先退回到最后显示的帧
+    pipeline_.stop();
+    updateCandidateFloor(false);
+
     frameNumber = qBound(0, frameNumber, totalFrames_ - 1);
-    videoCapture_.set(cv::CAP_PROP_POS_FRAMES, frameNumber);
-    currentFrame_ = frameNumber;
+    tracker_.reset();
+    tiledDetector_.reset();
+    motionGate_.reset();
+
+    if (resume) {
+        seekCapture(frameNumber);
+        currentFrame_ = frameNumber;
+        startPipeline();
+    } else {
+        // 来回拖动时已显示过的帧直接从缓存取
+        showFrame(frameNumber + 1, 0);
+    }
+}
 
-    if (!isPlaying_) {
-        processNextFrame();
+void MediaProcessor::stepForward()
+{
+    if (mediaType_ != VideoType || !videoCapture_.isOpened()) return;
+    if (pipeline_.isRunning()) {
+        pause();
+    }
+    if (currentFrame_ >= totalFrames_) return;
+    showFrame(currentFrame_ + 1, 1);
+}
+
+void MediaProcessor::stepBackward()
+{
+    if (mediaType_ != VideoType || !videoCapture_.isOpened()) return;
+    if (pipeline_.isRunning()) {
+        pause();
+    }
+    if (currentFrame_ <= 1) return;
+    // 倒退时跟踪和运动参考帧都不连续
+    tracker_.reset();
+    tiledDetector_.reset();
+    motionGate_.reset();
+    showFrame(currentFrame_ - 1, -1);
+}
+
+void MediaProcessor::showFrame(int index, int direction)
+{
+    prefetchUntil_ = -1;
+    FramePacket& packet = stepPacket_;
+    FrameCache::Entry entry;
+    if (frameCache_.lookup(index, entry)) {
+        packet.frame = entry.frame;
+        packet.timestampMs = entry.timestampMs;
+        packet.decodedAt = std::chrono::steady_clock::time_point();
+    } else {
+        // 后退未命中：从关键帧解码到目标帧本来就要经过前面这些帧，顺便放入缓存
+        const int first = direction < 0 ? std::max(1, index - kBackwardCacheFrames + 1) : index;
+        seekCapture(first - 1);
+        for (int i = first; i < index; ++i) {
+            FrameCache::Entry decoded;
+            if (!decodeFrame(decoded.frame)) {
+                break;
+            }
+            decoded.timestampMs = videoCapture_.get(cv::CAP_PROP_POS_MSEC);
+            ++decodedFrame_;
+            frameCache_.insert(decodedFrame_, decoded);
+        }
+        if (decodedFrame_ != index - 1) {
+            seekCapture(index - 1);
+        }
+        packet.frame.release();     // 不覆盖缓存中的帧
+        if (!decodeFrame(packet.frame, &packet.decodedAt)) {
+            stop();
+            emit statusMessage(tr("视频播放完毕"));
+            return;
+        }
+        packet.timestampMs = videoCapture_.get(cv::CAP_PROP_POS_MSEC);
+        ++decodedFrame_;
+    }
+    packet.index = index;
+
+    if (!entry.processed.empty() && entry.paramsVersion == paramsVersion_) {
+        packet.processed = entry.processed;
+        packet.result = entry.result;
+        packet.paramsVersion = entry.paramsVersion;
+        packet.skippedFrames = -1;
+    } else {
+        processFrame(packet.frame, packet);
+    }
+    presentFrame(packet, true);
+    emitFrameCacheStats();
+    emit latencyStatsChanged();
+
+    if (direction > 0) {
+        schedulePrefetch(index + kPrefetchFrames);
+    }
+}
+
+void MediaProcessor::schedulePrefetch(int lastIndex)
+{
+    if (!frameCache_.enabled()) return;
+    prefetchUntil_ = std::min(lastIndex, totalFrames_.load());
+    if (!prefetchQueued_) {
+        prefetchQueued_ = true;
+        QMetaObject::invokeMethod(this, "prefetchNext", Qt::QueuedConnection);
+    }
+}
+
+void MediaProcessor::prefetchNext()
+{
+    prefetchQueued_ = false;
+    if (prefetchUntil_ < 0 || pipeline_.isRunning() ||
+        mediaType_ != VideoType || !videoCapture_.isOpened()) {
+        return;
+    }
+
+    // 只从当前解码位置顺序向后读，位置已被定位改变时停止
+    const int next = decodedFrame_ + 1;
+    if (decodedFrame_ < currentFrame_ || next > prefetchUntil_) {
+        prefetchUntil_ = -1;
+        return;
+    }
+    if (frameCache_.contains(next)) {
+        if (!videoCapture_.grab()) {
+            prefetchUntil_ = -1;
+            return;
+        }
+    } else {
+        FrameCache::Entry entry;
+        if (!decodeFrame(entry.frame)) {
+            prefetchUntil_ = -1;
+            return;
+        }
+        entry.timestampMs = videoCapture_.get(cv::CAP_PROP_POS_MSEC);
+        frameCache_.insert(next, entry);
+    }
+    decodedFrame_ = next;
+
+    prefetchQueued_ = true;
+    QMetaObject::invokeMethod(this, "prefetchNext", Qt::QueuedConnection);
+}
+
+void MediaProcessor::setFrameCacheSize(int megabytes)
+{
+    frameCache_.setCapacity(static_cast<size_t>(std::max(0, megabytes)) << 20);
+    emitFrameCacheStats();
+}
+
+void MediaProcessor::previewFrame(int frameNumber)
+{
+    if (mediaType_ != VideoType || !videoCapture_.isOpened()) return;
+
+    // 没有索引时预览和精确定位一样慢，等松开进度条再定位
+    if (!keyframeIndex_) return;
+
+    if (pipeline_.isRunning()) {
+        pipeline_.stop();
+        updateCandidateFloor(false);
+        resumeAfterSeek_ = true;
+    }
+
+    // 预览只落在关键帧上，拖动时每跨过一个 GOP 才解码一次
+    const int key = keyframeIndex_->nearestKeyframe(qBound(0, frameNumber, totalFrames_ - 1));
+    if (key == previewKeyframe_) return;
+    previewKeyframe_ = key;
+
+    // 向前拖动到下一个关键帧时继续解码通常比重新定位少解码一段
+    seekCapture(key);
+    FramePacket& packet = stepPacket_;
+    packet.frame.release();
+    if (!decodeFrame(packet.frame, &packet.decodedAt)) {
+        decodedFrame_ = -1;
+        return;
+    }
+    decodedFrame_ = key + 1;
+    packet.index = decodedFrame_;
+    packet.processed = packet.frame;
+    packet.result = emptyResult_;
+    packet.skippedFrames = -1;
+    packet.paramsVersion = -1;
+    presentFrame(packet, true);
+}
+
+void MediaProcessor::seekCapture(int frame)
+{
+    if (!keyframeIndex_) {
+        videoCapture_.set(cv::CAP_PROP_POS_FRAMES, frame);
+        decodedFrame_ = frame;
+        return;
+    }
+
+    // 后端定位时自己会退到前面的关键帧再解码到目标，直接定位到目标帧；
+    // 目标在后面且比定位要解码的帧少时，继续向后解码
+    if (keyframeIndex_->shouldSeek(decodedFrame_, frame)) {
+        videoCapture_.set(cv::CAP_PROP_POS_FRAMES, frame);
+        decodedFrame_ = frame;
+    }
+    // grab 只解码不做颜色转换
+    while (decodedFrame_ < frame && videoCapture_.grab()) {
+        ++decodedFrame_;
+    }
+}
+
+void MediaProcessor::openKeyframeIndex(const QString& filePath)
+{
+    const QFileInfo fileInfo(filePath);
+    // 视频大小或修改时间变化后旧索引失效
+    const std::string signature = QString("%1:%2")
+                                      .arg(fileInfo.size())
+                                      .arg(fileInfo.lastModified().toMSecsSinceEpoch())
+                                      .toStdString();
+    // 优先保存在视频旁边，目录不可写时保存到应用数据目录
+    const std::string localPath = rm_buff::KeyframeIndex::pathFor(filePath.toStdString());
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/keyframes";
+    const QByteArray pathHash = QCryptographicHash::hash(fileInfo.absoluteFilePath().toUtf8(),
+                                                         QCryptographicHash::Md5).toHex();
+    const std::string cachePath = (cacheDir + "/" + QString::fromLatin1(pathHash) + ".kfidx").toStdString();
+
+    std::unique_ptr<rm_buff::KeyframeIndex> index(new rm_buff::KeyframeIndex);
+    if (index->load(localPath, signature) || index->load(cachePath, signature)) {
+        {
+            std::lock_guard<std::mutex> lock(indexMutex_);
+            pendingIndex_ = std::move(index);
+        }
+        onKeyframeIndexBuilt();
+        return;
+    }
+
+    indexCancel_ = false;
+    indexThread_ = std::thread([this, videoPath = filePath.toStdString(), signature,
+                                localPath, cacheDir, cachePath]() {
+        std::unique_ptr<rm_buff::KeyframeIndex> built(new rm_buff::KeyframeIndex);
+        if (!built->build(videoPath, &indexCancel_)) {
+            if (!indexCancel_) {
+                emit statusMessage(tr("无法建立关键帧索引，定位将逐帧解码"));
+            }
+            return;
+        }
+        if (!built->save(localPath, signature)) {
+            QDir().mkpath(cacheDir);
+            if (!built->save(cachePath, signature)) {
+                qWarning() << "无法保存关键帧索引";
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(indexMutex_);
+            pendingIndex_ = std::move(built);
+        }
+        QMetaObject::invokeMethod(this, "onKeyframeIndexBuilt", Qt::QueuedConnection);
+    });
+}
+
+void MediaProcessor::cancelKeyframeIndex()
+{
+    indexCancel_ = true;
+    if (indexThread_.joinable()) {
+        indexThread_.join();
+    }
+    std::lock_guard<std::mutex> lock(indexMutex_);
+    pendingIndex_.reset();
+}
+
+void MediaProcessor::onKeyframeIndexBuilt()
+{
+    {
+        std::lock_guard<std::mutex> lock(indexMutex_);
+        if (!pendingIndex_) return;
+        keyframeIndex_ = std::move(pendingIndex_);
+    }
+
+    // CAP_PROP_FRAME_COUNT 由时长和帧率估算，以索引中的实际帧数为准
+    if (keyframeIndex_->frameCount() != totalFrames_) {
+        totalFrames_ = keyframeIndex_->frameCount();
+        emit frameNumberChanged(currentFrame_, totalFrames_);
+    }
+    emit statusMessage(tr("关键帧索引: %1 帧, %2 个关键帧")
+                           .arg(keyframeIndex_->frameCount())
+                           .arg(keyframeIndex_->keyframeCount()));
+}
+
+void MediaProcessor::publishParams(const ProcessingParams& params)
+{
+    {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        params_ = params;
+    }
+    ++paramsVersion_;
+}
+
+void MediaProcessor::syncParams()
+{
+    const int version = paramsVersion_.load();
+    if (version == activeVersion_) {
+        return;
+    }
+
+    ProcessingParams next;
+    {
+        std::lock_guard<std::mutex> lock(paramsMutex_);
+        next = params_;
+    }
+    const ProcessingParams prev = active_;
+    const bool first = activeVersion_ < 0;
+    active_ = next;
+    activeVersion_ = version;
+
+    applyDetectorThresholds();
+
+    rm_buff::TileConfig tileConfig = tiledDetector_.getConfig();
+    tileConfig.adaptive = (next.tiling == TilingAdaptive);
+    tiledDetector_.setConfig(tileConfig);
+
+    rm_buff::TrackerConfig trackerConfig = tracker_.getConfig();
+    trackerConfig.full_detect_interval = std::max(1, next.fullDetectInterval);
+    tracker_.setConfig(trackerConfig);
+    if (first || next.tracking != prev.tracking) {
+        tracker_.reset();
+    }
+
+    // 影响检测结果的参数变化后，下一帧必须重新推理
+    motionGate_.setThreshold(next.motionThreshold);
+    if (first || next.confidence != prev.confidence || next.nms != prev.nms ||
+        next.tiling != prev.tiling || next.armorMode != prev.armorMode ||
+        next.motionGate != prev.motionGate) {
+        motionGate_.reset();
     }
 }
 
 void MediaProcessor::setDisplayMode(DisplayMode mode)
 {
-    displayMode_ = mode;
+    ProcessingParams params = params_;
+    params.displayMode = mode;
+    publishParams(params);
 
     if (mediaType_ == ImageType) {
         processCurrentImage();
@@ -270,34 +1011,83 @@ void MediaProcessor::setDisplayMode(DisplayMode mode)
 
 void MediaProcessor::setConfidenceThreshold(double threshold)
 {
-    confidenceThreshold_ = threshold;
-    if (detector_) {
-        detector_->setConfThreshold(threshold);
-    }
+    ProcessingParams params = params_;
+    params.confidence = threshold;
+    publishParams(params);
 
-    if (mediaType_ == ImageType && displayMode_ == DetectionMode) {
-        processCurrentImage();
+    // 当前图像或暂停的帧只需对缓存的候选重新筛选
+    if (!refilterDetections()) {
+        redetectCurrentFrame();
     }
 }
 
 void MediaProcessor::setNMSThreshold(double threshold)
 {
-    nmsThreshold_ = threshold;
-    if (detector_) {
-        detector_->setNMSThreshold(threshold);
+    ProcessingParams params = params_;
+    params.nms = threshold;
+    publishParams(params);
+
+    // 当前图像或暂停的帧只需对缓存的候选重新筛选
+    if (!refilterDetections()) {
+        redetectCurrentFrame();
     }
+}
+
+void MediaProcessor::setMotionGateEnabled(bool enabled)
+{
+    ProcessingParams params = params_;
+    params.motionGate = enabled;
+    publishParams(params);
+}
+
+void MediaProcessor::setMotionThreshold(double threshold)
+{
+    ProcessingParams params = params_;
+    params.motionThreshold = threshold;
+    publishParams(params);
+}
+
+void MediaProcessor::resetMotionStats()
+{
+    motionGate_.reset();
+    skippedFrames_ = 0;
+    gatedFrames_ = 0;
+    emit skippedFramesChanged(skippedFrames_, gatedFrames_);
+}
+
+void MediaProcessor::setTilingMode(TilingMode mode)
+{
+    ProcessingParams params = params_;
+    params.tiling = mode;
+    publishParams(params);
 
-    if (mediaType_ == ImageType && displayMode_ == DetectionMode) {
+    if (mediaType_ == ImageType && params_.displayMode == DetectionMode) {
         processCurrentImage();
     }
 }
 
+void MediaProcessor::setTrackingEnabled(bool enabled)
+{
+    ProcessingParams params = params_;
+    params.tracking = enabled;
+    publishParams(params);
+}
+
+void MediaProcessor::setFullDetectInterval(int frames)
+{
+    ProcessingParams params = params_;
+    params.fullDetectInterval = std::max(1, frames);
+    publishParams(params);
+}
+
 void MediaProcessor::setROISize(int width, int height)
 {
-    roiWidth_ = width;
-    roiHeight_ = height;
+    ProcessingParams params = params_;
+    params.roiWidth = width;
+    params.roiHeight = height;
+    publishParams(params);
 
-    if (mediaType_ == ImageType && displayMode_ == ROIMode) {
+    if (mediaType_ == ImageType && params_.displayMode == ROIMode) {
         processCurrentImage();
     }
 }
@@ -307,105 +1097,349 @@ void MediaProcessor::setPlaybackSpeed(double speed)
     playbackSpeed_ = speed;
 
     if (isPlaying_) {
-        int interval = static_cast<int>(1000.0 / (fps_ * playbackSpeed_));
-        timer_->setInterval(interval);
+        pipeline_.setPlaybackRate(playbackSpeed_);
+    }
+}
+
+void MediaProcessor::updateCandidateFloor(bool streaming)
+{
+    const float floor = streaming ? 0.0f : kCandidateFloor;
+    for (rm_buff::Detector* detector : {detector_.get(), armorDetector_.get()}) {
+        if (detector && detector->getCandidateFloor() != floor) {
+            detector->setCandidateFloor(floor);
+        }
+    }
+    if (streaming) {
+        candidatesFrame_ = -1;
     }
 }
 
+void MediaProcessor::redetectCurrentFrame()
+{
+    if (params_.displayMode != DetectionMode) return;
+
+    if (mediaType_ == ImageType) {
+        processCurrentImage();
+    } else if (mediaType_ == VideoType && videoCapture_.isOpened() && !pipeline_.isRunning() &&
+               currentFrame_ > 0) {
+        // 暂停在播放时检测的帧上：按新阈值重新检测一次并保留候选，之后再调阈值只需重新筛选
+        // 同一帧再次检测，运动门限会判为静止，跟踪也不应再更新一次
+        tracker_.reset();
+        tiledDetector_.reset();
+        motionGate_.reset();
+        showFrame(currentFrame_, 0);
+    }
+}
+
+bool MediaProcessor::refilterDetections()
+{
+    // 检测器只在流水线停止时由界面线程使用；候选必须来自当前显示的帧
+    if (pipeline_.isRunning() || !detector_ || !lastResult_ || candidatesFrame_ < 0) {
+        return false;
+    }
+    const int shown = mediaType_ == ImageType ? 0 : currentFrame_.load();
+    if (candidatesFrame_ != shown) {
+        return false;
+    }
+
+    syncParams();
+    if (active_.displayMode != DetectionMode || !detector_->CanRefilter() ||
+        (candidatesArmor_ && !(armorDetector_ && armorDetector_->CanRefilter()))) {
+        return false;
+    }
+
+    std::shared_ptr<DetectionResult> result = resultPool_.acquire();
+    result->detected = true;
+    result->regions = lastResult_->regions;
+    const std::vector<rm_buff::Blade>& blades = detector_->Refilter();
+    result->blades.assign(blades.begin(), blades.end());
+    if (candidatesArmor_) {
+        appendArmor(armorDetector_->Refilter(), result->blades);
+    }
+    lastResult_ = result;
+
+    // 画面不变，重新发出结果和上次的图像让界面重绘叠加层
+    QImage image;
+    {
+        std::lock_guard<std::mutex> lock(presentMutex_);
+        image = lastDisplayImage_;
+    }
+    emit detectionCountChanged(static_cast<int>(result->blades.size()));
+    emit detectionResults(result);
+    emit frameReady(image);
+    return true;
+}
+
 void MediaProcessor::processCurrentImage()
 {
     if (mediaType_ != ImageType || currentImage_.empty()) return;
 
-    cv::Mat processed = processFrame(currentImage_);
-    QImage qImage = matToQImage(processed);
-    lastProcessedImage_ = qImage;
-    emit frameReady(qImage);
+    stepPacket_.index = 0;
+    processFrame(currentImage_, stepPacket_);
+    presentFrame(stepPacket_);
+    emit latencyStatsChanged();
 }
 
-void MediaProcessor::processNextFrame()
+QImage MediaProcessor::getCurrentProcessedImage() const
 {
-    if (mediaType_ != VideoType || !videoCapture_.isOpened()) return;
+    cv::Mat processed;
+    {
+        std::lock_guard<std::mutex> lock(presentMutex_);
+        processed = lastProcessed_;
+    }
+    return matToQImage(processed);
+}
+
+QSize MediaProcessor::getCurrentProcessedSize() const
+{
+    std::lock_guard<std::mutex> lock(presentMutex_);
+    return QSize(lastProcessed_.cols, lastProcessed_.rows);
+}
+
+void MediaProcessor::setDisplayBounds(const QSize& bounds)
+{
+    std::lock_guard<std::mutex> lock(presentMutex_);
+    displayBounds_ = bounds;
+}
+
+void MediaProcessor::refreshDisplayImage()
+{
+    if (pipeline_.isRunning()) return;
+
+    cv::Mat processed;
+    {
+        std::lock_guard<std::mutex> lock(presentMutex_);
+        processed = lastProcessed_;
+    }
+    if (processed.empty()) return;
 
-    cv::Mat frame;
-    videoCapture_ >> frame;
+    QImage image = toDisplayImage(processed);
+    {
+        std::lock_guard<std::mutex> lock(presentMutex_);
+        lastDisplayImage_ = image;
+    }
+    emit frameReady(image);
+}
+
+void MediaProcessor::processNextFrame()
+{
+    if (mediaType_ != VideoType || !videoCapture_.isOpened() || pipeline_.isRunning()) return;
 
-    if (frame.empty()) {
+    FramePacket& packet = stepPacket_;
+    packet.frame.release();         // 上一帧可能仍在帧缓存中
+    if (!decodeFrame(packet.frame, &packet.decodedAt)) {
         stop();
         emit statusMessage(tr("视频播放完毕"));
         return;
     }
+    packet.index = ++decodedFrame_;
 
-    currentFrame_ = static_cast<int>(videoCapture_.get(cv::CAP_PROP_POS_FRAMES));
-    emit frameNumberChanged(currentFrame_, totalFrames_);
+    processFrame(packet.frame, packet);
+    presentFrame(packet, true);
+    emit latencyStatsChanged();
+}
 
-    cv::Mat processed = processFrame(frame);
-    QImage qImage = matToQImage(processed);
-    lastProcessedImage_ = qImage;
-    emit frameReady(qImage);
+bool MediaProcessor::decodeFrame(cv::Mat& frame, std::chrono::steady_clock::time_point* decodedAt)
+{
+    // 缓冲仍被其他地方（帧缓存、显示图像）引用时不能原地覆盖，改为分配新缓冲
+    if (frame.u && frame.u->refcount > 1) {
+        frame.release();
+    }
+    const auto start = LatencyStats::Clock::now();
+    if (!videoCapture_.read(frame) || frame.empty()) {
+        return false;
+    }
+    const auto end = LatencyStats::Clock::now();
+    latency_.record(LatencyStats::Decode, start, end);
+    if (decodedAt) {
+        *decodedAt = end;
+    }
+    return true;
 }
 
-cv::Mat MediaProcessor::processFrame(const cv::Mat& frame)
+void MediaProcessor::processFrame(const cv::Mat& frame, FramePacket& packet)
 {
-    cv::Mat result;
+    syncParams();
+    packet.result = emptyResult_;
+    packet.skippedFrames = -1;
+    packet.paramsVersion = activeVersion_;
+    const auto start = LatencyStats::Clock::now();
 
-    switch (displayMode_) {
+    switch (active_.displayMode) {
         case OriginalMode:
-            result = frame.clone();
+            packet.processed = frame;
             break;
 
         case DetectionMode:
-            result = detectObjects(frame);
+            packet.processed = detectObjects(frame, packet);
             break;
 
         case BinaryMode:
-            result = applyBinary(frame);
+            packet.processed = applyBinary(frame);
             break;
 
         case ROIMode:
-            result = extractROI(frame);
+            packet.processed = extractROI(frame);
             break;
     }
+    latency_.record(LatencyStats::Process, start, LatencyStats::Clock::now());
+}
 
-    return result;
+void MediaProcessor::presentFrame(FramePacket& packet, bool cacheFrame)
+{
+    const auto convertStart = LatencyStats::Clock::now();
+    QImage qImage = toDisplayImage(packet.processed);
+    latency_.record(LatencyStats::Convert, convertStart, LatencyStats::Clock::now());
+    {
+        std::lock_guard<std::mutex> lock(presentMutex_);
+        lastProcessed_ = packet.processed;
+        lastDisplayImage_ = qImage;
+    }
+
+    if (packet.index > 0) {
+        currentFrame_ = packet.index;
+        emit frameNumberChanged(packet.index, totalFrames_);
+    }
+    if (packet.skippedFrames >= 0) {
+        emit skippedFramesChanged(packet.skippedFrames, packet.gatedFrames);
+    }
+    if (packet.result->detected) {
+        emit detectionCountChanged(static_cast<int>(packet.result->blades.size()));
+    }
+    emit detectionResults(packet.result);
+    if (packet.decodedAt != std::chrono::steady_clock::time_point()) {
+        emit frameDecodedAt(std::chrono::duration_cast<std::chrono::microseconds>(
+                                packet.decodedAt.time_since_epoch()).count());
+        packet.decodedAt = std::chrono::steady_clock::time_point();
+    }
+    emit frameReady(qImage);
+
+    const bool cached = cacheFrame && frameCache_.enabled() && packet.index > 0 &&
+                        !packet.frame.empty();
+    if (cached) {
+        FrameCache::Entry entry;
+        entry.frame = packet.frame;
+        entry.processed = packet.processed;
+        entry.result = packet.result;
+        entry.paramsVersion = packet.paramsVersion;
+        entry.timestampMs = packet.timestampMs;
+        frameCache_.insert(packet.index, entry);
+    }
+
+    // 帧缓冲放入了帧缓存或被不缩放的显示图像直接包装时交给它们持有，解码阶段分配新缓冲；
+    // 只被 lastProcessed_ 引用时与上一帧的缓冲交换，其余情况（二值化等模式）缓冲原样回到流水线复用
+    const bool sharesFrame = !packet.frame.empty() && packet.processed.u == packet.frame.u;
+    if (cached || (sharesFrame && qImage.constBits() == packet.processed.data)) {
+        packet.frame.release();
+    } else if (sharesFrame) {
+        std::swap(packet.frame, lastFrame_);
+    }
+    packet.processed.release();
+    packet.result.reset();
 }
 
-cv::Mat MediaProcessor::detectObjects(const cv::Mat& frame)
+void MediaProcessor::appendArmor(const std::vector<rm_buff::Blade>& armors,
+                                 std::vector<rm_buff::Blade>& out) const
 {
-    cv::Mat result = frame.clone();
+    for (const auto& armor : armors) {
+        if ((active_.armorMode == ArmorRed && armor.cls != rm_buff::BladeClass::Red) ||
+            (active_.armorMode == ArmorBlue && armor.cls != rm_buff::BladeClass::Blue)) {
+            continue;
+        }
+        out.push_back(armor);
+    }
+}
 
+cv::Mat MediaProcessor::detectObjects(const cv::Mat& frame, FramePacket& packet)
+{
+    // 检测结果写入共享的结果缓冲，由界面在显示分辨率下绘制，原始帧不再拷贝和修改
     if (!detector_) {
-        cv::putText(result, "模型未能正确加载", cv::Point(50, 50),
-                   cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 255), 2);
-        return result;
+        std::shared_ptr<DetectionResult> result = resultPool_.acquire();
+        result->message = tr("模型未能正确加载");
+        packet.result = result;
+        return frame;
+    }
+
+    // 运动门限：画面与上次推理时相比几乎无变化，直接复用上次的结果
+    if (active_.motionGate && mediaType_ == VideoType) {
+        ++gatedFrames_;
+        const bool moved = motionGate_.hasMotion(frame);
+        if (!moved) {
+            ++skippedFrames_;
+        }
+        packet.skippedFrames = skippedFrames_;
+        packet.gatedFrames = gatedFrames_;
+        if (!moved && lastResult_) {
+            packet.result = lastResult_;
+            return frame;
+        }
     }
 
+    std::shared_ptr<DetectionResult> result = resultPool_.acquire();
+    result->detected = true;
+    candidatesFrame_ = -1;
+
     // 使用你的检测器
     try {
-        auto blades = detector_->Detect(result);
-        detector_->draw_blade(result);
-
-        // 发送检测结果
-        emit detectionCountChanged(blades.size());
-
-        QList<QVariantMap> detections;
-        for (const auto& blade : blades) {
-            QVariantMap det;
-            det["label"] = QString::fromStdString(blade.label);
-            det["confidence"] = blade.prob;
-            det["x"] = blade.rect.x;
-            det["y"] = blade.rect.y;
-            det["width"] = blade.rect.width;
-            det["height"] = blade.rect.height;
-            detections.append(det);
+        const bool armorActive = armorDetector_ && active_.armorMode != ArmorOff;
+        bool armorDone = false;
+        const std::vector<rm_buff::Blade>* detected = nullptr;
+        if (active_.tiling != TilingOff) {
+            // 分块检测：高分辨率画面切成重叠的分块，远处的小目标不被缩没
+            detected = &tiledDetector_.Detect(*detector_, frame);
+            const std::vector<cv::Rect>& tiles = tiledDetector_.lastTiles();
+            result->regions.assign(tiles.begin(), tiles.end());
+        } else {
+            // 跟踪模式只用于视频：间隔帧在预测区域内裁剪检测，其余帧整帧检测
+            const bool useTracking = active_.tracking && mediaType_ == VideoType;
+            const bool fullFrame = !useTracking || tracker_.needFullDetect();
+            const cv::Rect roi = fullFrame ? cv::Rect(0, 0, frame.cols, frame.rows)
+                                           : tracker_.predictRoi(frame.size());
+
+            if (fullFrame && armorActive) {
+                // 整帧检测时两个模型在同一帧上同时推理，结果按加入顺序取出
+                group_.Detect(frame);
+                detected = &group_.result(0);
+                armorDone = true;
+            } else {
+                detected = fullFrame ? &detector_->Detect(frame)
+                                     : &detector_->Detect(frame, roi);
+            }
+            if (useTracking) {
+                tracker_.update(*detected, roi, fullFrame);
+                if (!fullFrame) {
+                    result->regions.push_back(roi);
+                }
+            }
+        }
+
+        result->blades.assign(detected->begin(), detected->end());
+
+        // 能量机关检测器的阶段耗时（分块检测为各块之和，分块并行推理时不经过同步槽，由分块检测器汇总）
+        const rm_buff::Detector::StageTimings& timings = active_.tiling != TilingOff
+            ? tiledDetector_.lastTimings()
+            : detector_->getLastTimings();
+        latency_.record(LatencyStats::Preprocess, timings.preprocess_ms);
+        latency_.record(LatencyStats::Inference, timings.infer_ms);
+        latency_.record(LatencyStats::Postprocess, timings.postprocess_ms);
+        if (armorActive) {
+            // 合并装甲板结果；分块和裁剪检测时装甲板单独整帧推理
+            appendArmor(armorDone ? group_.result(1) : armorDetector_->Detect(frame), result->blades);
+        }
+
+        // 分块检测的候选分散在多次推理中，无法只重新筛选；播放时不保留候选
+        if (active_.tiling == TilingOff && detector_->getCandidateFloor() > 0.0f) {
+            candidatesFrame_ = mediaType_ == ImageType ? 0 : packet.index;
+            candidatesArmor_ = armorActive;
         }
-        emit detectionResults(detections);
 
     } catch (const std::exception& e) {
-        cv::putText(result, "识别系统出错", cv::Point(50, 50),
-                   cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 255), 2);
+        result->message = tr("识别系统出错: %1").arg(e.what());
     }
 
-    return result;
+    lastResult_ = result;
+    packet.result = result;
+    return frame;
 }
 
 cv::Mat MediaProcessor::applyBinary(const cv::Mat& frame)
@@ -426,10 +1460,12 @@ cv::Mat MediaProcessor::extractROI(const cv::Mat& frame)
 
     int centerX = frame.cols / 2;
     int centerY = frame.rows / 2;
-    int roiX = std::max(0, centerX - roiWidth_ / 2);
-    int roiY = std::max(0, centerY - roiHeight_ / 2);
+    const int roiWidth = active_.roiWidth;
+    const int roiHeight = active_.roiHeight;
+    int roiX = std::max(0, centerX - roiWidth / 2);
+    int roiY = std::max(0, centerY - roiHeight / 2);
 
-    cv::Rect roiRect(roiX, roiY, roiWidth_, roiHeight_);
+    cv::Rect roiRect(roiX, roiY, roiWidth, roiHeight);
     roiRect = roiRect & cv::Rect(0, 0, frame.cols, frame.rows);
 
     if (!roiRect.empty()) {
@@ -460,17 +1496,58 @@ QImage MediaProcessor::matToQImage(const cv::Mat& mat)
         return QImage();
     }
 
-    cv::Mat rgb;
-    if (mat.channels() == 3) {
-        cv::cvtColor(mat, rgb, cv::COLOR_BGR2RGB);
-    } else if (mat.channels() == 1) {
-        cv::cvtColor(mat, rgb, cv::COLOR_GRAY2RGB);
-    } else {
-        rgb = mat;
+    cv::Mat source = mat;
+    QImage::Format format;
+    switch (mat.type()) {
+        case CV_8UC3:
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+            format = QImage::Format_BGR888;
+#else
+            // source 与 mat 共享缓冲，先断开再转换，不能原地交换调用方帧的通道
+            source = cv::Mat();
+            cv::cvtColor(mat, source, cv::COLOR_BGR2RGB);
+            format = QImage::Format_RGB888;
+#endif
+            break;
+        case CV_8UC1:
+            format = QImage::Format_Grayscale8;
+            break;
+        case CV_8UC4:
+            format = QImage::Format_ARGB32;     // 小端序下内存布局即 BGRA
+            break;
+        default:
+            return QImage();
+    }
+
+    // QImage 持有 Mat 的一份引用，最后一个副本析构时在清理回调中释放
+    // 以只读方式包装，界面需要修改时 QImage 自行拷贝，不会写回帧数据
+    cv::Mat* owner = new cv::Mat(source);
+    return QImage(static_cast<const uchar*>(owner->data), owner->cols, owner->rows,
+                  static_cast<int>(owner->step), format,
+                  [](void* info) { delete static_cast<cv::Mat*>(info); }, owner);
+}
+
+QImage MediaProcessor::toDisplayImage(const cv::Mat& mat)
+{
+    if (mat.empty()) {
+        return QImage();
     }
 
-    QImage qImage(rgb.data, rgb.cols, rgb.rows, rgb.step,
-                  QImage::Format_RGB888);
+    QSize bounds;
+    {
+        std::lock_guard<std::mutex> lock(presentMutex_);
+        bounds = displayBounds_;
+    }
+
+    // 在显示线程中一次缩放到显示尺寸，界面线程只需把图像放上标签
+    const QSize source(mat.cols, mat.rows);
+    const QSize target = bounds.isEmpty() ? source : source.scaled(bounds, Qt::KeepAspectRatio);
+    if (target.isEmpty() || target == source) {
+        return matToQImage(mat);
+    }
 
-    return qImage.copy();
+    cv::Mat scaled;
+    cv::resize(mat, scaled, cv::Size(target.width(), target.height()), 0, 0,
+               target.width() < source.width() ? cv::INTER_AREA : cv::INTER_LINEAR);
+    return matToQImage(scaled);
 }
@@ -0,0 +1,55 @@
+#include "motiongate.h"
+#include <algorithm>
+
+namespace rm_buff
+{
+
+MotionGate::MotionGate(double threshold, int sample_width, int cell_size)
+    : threshold_(threshold)
+    , sample_width_(std::max(8, sample_width))
+    , cell_size_(std::max(1, cell_size))
+{
+}
+
+bool MotionGate::hasMotion(const cv::Mat& frame)
+{
+    if (frame.empty()) {
+        return true;
+    }
+
+    // 降到 sample_width 宽再比较，开销只有几十微秒且对噪声不敏感
+    const int height = std::max(1, frame.rows * sample_width_ / std::max(1, frame.cols));
+    cv::resize(frame, small_, cv::Size(sample_width_, height), 0, 0, cv::INTER_AREA);
+    if (small_.channels() == 3) {
+        cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
+    } else {
+        small_.copyTo(gray_);
+    }
+
+    // 尺寸变化或首帧时直接判定为有变化
+    if (reference_.size() != gray_.size()) {
+        gray_.copyTo(reference_);
+        last_score_ = 255.0;
+        return true;
+    }
+
+    // INTER_AREA 缩小即每格求平均，取变化最大的一格
+    cv::absdiff(gray_, reference_, diff_);
+    const cv::Size grid(std::max(1, diff_.cols / cell_size_), std::max(1, diff_.rows / cell_size_));
+    cv::resize(diff_, cells_, grid, 0, 0, cv::INTER_AREA);
+    cv::minMaxLoc(cells_, nullptr, &last_score_);
+    if (last_score_ < threshold_) {
+        return false;
+    }
+
+    std::swap(reference_, gray_);
+    return true;
+}
+
+void MotionGate::reset()
+{
+    reference_.release();
+    last_score_ = 0.0;
+}
+
+} // namespace rm_buff
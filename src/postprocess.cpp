@@ -0,0 +1,340 @@
+#include "postprocess.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RM_BUFF_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace rm_buff
+{
+
+void CandidateBuffer::reserve(size_t n, int kpt_count)
+{
+    kpt_num = kpt_count;
+    cx.reserve(n);
+    cy.reserve(n);
+    w.reserve(n);
+    h.reserve(n);
+    score.reserve(n);
+    class_id.reserve(n);
+    batch.reserve(n);
+    kpt.reserve(n * kpt_count * 2);
+    survivors.reserve(n);
+}
+
+void CandidateBuffer::clear()
+{
+    cx.clear();
+    cy.clear();
+    w.clear();
+    h.clear();
+    score.clear();
+    class_id.clear();
+    batch.clear();
+    kpt.clear();
+    survivors.clear();
+}
+
+void filter_candidates(CandidateBuffer& cand, float conf_thres)
+{
+    const size_t n = cand.size();
+    const size_t kpt_stride = static_cast<size_t>(cand.kpt_num) * 2;
+    size_t out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (cand.score[i] < conf_thres) {
+            continue;
+        }
+        if (out != i) {
+            cand.cx[out] = cand.cx[i];
+            cand.cy[out] = cand.cy[i];
+            cand.w[out] = cand.w[i];
+            cand.h[out] = cand.h[i];
+            cand.score[out] = cand.score[i];
+            cand.class_id[out] = cand.class_id[i];
+            cand.batch[out] = cand.batch[i];
+            std::copy(cand.kpt.begin() + i * kpt_stride, cand.kpt.begin() + (i + 1) * kpt_stride,
+                      cand.kpt.begin() + out * kpt_stride);
+        }
+        ++out;
+    }
+    cand.cx.resize(out);
+    cand.cy.resize(out);
+    cand.w.resize(out);
+    cand.h.resize(out);
+    cand.score.resize(out);
+    cand.class_id.resize(out);
+    cand.batch.resize(out);
+    cand.kpt.resize(out * kpt_stride);
+}
+
+void NmsWorkspace::reserve(size_t n)
+{
+    x1.reserve(n);
+    y1.reserve(n);
+    x2.reserve(n);
+    y2.reserve(n);
+    area.reserve(n);
+    order.reserve(n);
+    suppressed.reserve(n);
+}
+
+namespace
+{
+
+// 候选数不超过该值时使用免排序的选择法
+constexpr size_t kSelectNmsLimit = 64;
+
+using detail::ScanFn;
+
+// 扫描内核：C > 0 时类别数为编译期常量，内层循环可完全展开；C == 0 时使用运行时的 cls_num
+
+template <int C>
+int scan_scalar(const float* cls, int num_anchors, int cls_num,
+                float thres, int begin, int* out)
+{
+    const int classes = C > 0 ? C : cls_num;
+    int count = 0;
+    for (int j = begin; j < num_anchors; ++j) {
+        float max_score = cls[j];
+        for (int k = 1; k < classes; ++k) {
+            float s = cls[k * num_anchors + j];
+            max_score = s > max_score ? s : max_score;
+        }
+        if (max_score >= thres) {
+            out[count++] = j;
+        }
+    }
+    return count;
+}
+
+#ifdef RM_BUFF_X86_DISPATCH
+
+template <int C>
+__attribute__((target("avx2")))
+int scan_avx2(const float* cls, int num_anchors, int cls_num,
+              float thres, int begin, int* out)
+{
+    const int classes = C > 0 ? C : cls_num;
+    const __m256 t = _mm256_set1_ps(thres);
+    int count = 0;
+    int j = begin;
+    for (; j + 8 <= num_anchors; j += 8) {
+        __m256 m = _mm256_loadu_ps(cls + j);
+        for (int k = 1; k < classes; ++k) {
+            m = _mm256_max_ps(m, _mm256_loadu_ps(cls + k * num_anchors + j));
+        }
+        unsigned mask = unsigned(_mm256_movemask_ps(_mm256_cmp_ps(m, t, _CMP_GE_OQ)));
+        // 绝大多数 anchor 不过阈值，mask 为 0 时直接跳过
+        while (mask) {
+            out[count++] = j + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return count + scan_scalar<C>(cls, num_anchors, cls_num, thres, j, out + count);
+}
+
+template <int C>
+__attribute__((target("avx512f")))
+int scan_avx512(const float* cls, int num_anchors, int cls_num,
+                float thres, int begin, int* out)
+{
+    const int classes = C > 0 ? C : cls_num;
+    const __m512 t = _mm512_set1_ps(thres);
+    int count = 0;
+    int j = begin;
+    for (; j + 16 <= num_anchors; j += 16) {
+        __m512 m = _mm512_loadu_ps(cls + j);
+        for (int k = 1; k < classes; ++k) {
+            m = _mm512_max_ps(m, _mm512_loadu_ps(cls + k * num_anchors + j));
+        }
+        unsigned mask = unsigned(_mm512_cmp_ps_mask(m, t, _CMP_GE_OQ));
+        while (mask) {
+            out[count++] = j + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return count + scan_scalar<C>(cls, num_anchors, cls_num, thres, j, out + count);
+}
+
+template <int C>
+ScanFn dispatch_scan()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return scan_avx512<C>;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return scan_avx2<C>;
+    }
+    return scan_scalar<C>;
+}
+
+#else
+
+template <int C>
+ScanFn dispatch_scan()
+{
+    return scan_scalar<C>;
+}
+
+#endif
+
+} // namespace
+
+ScanFn detail::select_scan(int cls_num)
+{
+    switch (cls_num) {
+    case 1: return dispatch_scan<1>();
+    case 2: return dispatch_scan<2>();
+    case 3: return dispatch_scan<3>();
+    case 4: return dispatch_scan<4>();
+    case 5: return dispatch_scan<5>();
+    case 6: return dispatch_scan<6>();
+    case 7: return dispatch_scan<7>();
+    case 8: return dispatch_scan<8>();
+    default: return dispatch_scan<0>();
+    }
+}
+
+namespace
+{
+
+inline float box_iou(const NmsWorkspace& ws, int a, int b)
+{
+    float iw = std::min(ws.x2[a], ws.x2[b]) - std::max(ws.x1[a], ws.x1[b]);
+    float ih = std::min(ws.y2[a], ws.y2[b]) - std::max(ws.y1[a], ws.y1[b]);
+    if (iw <= 0.0f || ih <= 0.0f) {
+        return 0.0f;
+    }
+    float inter = iw * ih;
+    float uni = ws.area[a] + ws.area[b] - inter;
+    return uni > 0.0f ? inter / uni : 0.0f;
+}
+
+inline bool same_group(const CandidateBuffer& cand, bool class_agnostic, int a, int b)
+{
+    return cand.batch[a] == cand.batch[b] &&
+           (class_agnostic || cand.class_id[a] == cand.class_id[b]);
+}
+
+} // namespace
+
+void non_max_suppression(
+    const CandidateBuffer& cand,
+    const NmsOptions& opts,
+    NmsWorkspace& ws,
+    std::vector<int>& keep)
+{
+    keep.clear();
+
+    const int n = int(cand.size());
+    if (n == 0 || opts.max_det <= 0) {
+        return;
+    }
+
+    // 中心点格式转为角点格式，预先计算面积
+    ws.x1.resize(n);
+    ws.y1.resize(n);
+    ws.x2.resize(n);
+    ws.y2.resize(n);
+    ws.area.resize(n);
+    for (int i = 0; i < n; ++i) {
+        float half_w = cand.w[i] * 0.5f;
+        float half_h = cand.h[i] * 0.5f;
+        ws.x1[i] = cand.cx[i] - half_w;
+        ws.y1[i] = cand.cy[i] - half_h;
+        ws.x2[i] = cand.cx[i] + half_w;
+        ws.y2[i] = cand.cy[i] + half_h;
+        ws.area[i] = cand.w[i] * cand.h[i];
+    }
+
+    ws.suppressed.assign(n, 0);
+
+    // 按 batch 下标分别计数，一张图的目标多不会挤占同 batch 中其他图的名额
+    int num_batches = 0;
+    for (int i = 0; i < n; ++i) {
+        num_batches = std::max(num_batches, cand.batch[i] + 1);
+    }
+    ws.kept.assign(num_batches, 0);
+    int open_batches = 0;       // 有候选且未达到上限的图数
+    for (int i = 0; i < n; ++i) {
+        if (ws.kept[cand.batch[i]]++ == 0) {
+            ++open_batches;
+        }
+    }
+    std::fill(ws.kept.begin(), ws.kept.end(), 0);
+
+    if (size_t(n) <= kSelectNmsLimit) {
+        // 选择法：每轮取剩余的最高分，然后抑制与之重叠的候选
+        while (open_batches > 0) {
+            int best = -1;
+            for (int i = 0; i < n; ++i) {
+                if (!ws.suppressed[i] && (best < 0 || cand.score[i] > cand.score[best])) {
+                    best = i;
+                }
+            }
+            if (best < 0) {
+                break;
+            }
+
+            keep.push_back(best);
+            ws.suppressed[best] = 1;
+            const int b = cand.batch[best];
+            if (++ws.kept[b] >= opts.max_det) {
+                // 该图已满，剩余候选不再参与
+                --open_batches;
+                for (int i = 0; i < n; ++i) {
+                    if (cand.batch[i] == b) {
+                        ws.suppressed[i] = 1;
+                    }
+                }
+                continue;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (!ws.suppressed[i] && same_group(cand, opts.class_agnostic, best, i) &&
+                    box_iou(ws, best, i) > opts.iou_thres) {
+                    ws.suppressed[i] = 1;
+                }
+            }
+        }
+        return;
+    }
+
+    // 候选较多时先排序，同分按下标保证结果稳定
+    ws.order.resize(n);
+    for (int i = 0; i < n; ++i) {
+        ws.order[i] = i;
+    }
+    std::sort(ws.order.begin(), ws.order.end(), [&cand](int a, int b) {
+        return cand.score[a] > cand.score[b] ||
+               (cand.score[a] == cand.score[b] && a < b);
+    });
+
+    for (int p = 0; p < n; ++p) {
+        const int idx = ws.order[p];
+        const int b = cand.batch[idx];
+        if (ws.suppressed[idx] || ws.kept[b] >= opts.max_det) {
+            continue;
+        }
+
+        keep.push_back(idx);
+        if (++ws.kept[b] >= opts.max_det) {
+            // 该图已满，之后只跳过它的候选；所有图都满时结束
+            if (--open_batches == 0) {
+                break;
+            }
+            continue;
+        }
+
+        for (int q = p + 1; q < n; ++q) {
+            const int other = ws.order[q];
+            if (!ws.suppressed[other] && same_group(cand, opts.class_agnostic, idx, other) &&
+                box_iou(ws, idx, other) > opts.iou_thres) {
+                ws.suppressed[other] = 1;
+            }
+        }
+    }
+}
+
+} // namespace rm_buff
@@ -0,0 +1,169 @@
+#include "precisioncheck.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace rm_buff
+{
+
+namespace
+{
+
+// 判定为同一目标的最小 IoU
+constexpr float kMatchIoU = 0.5f;
+
+float rect_iou(const cv::Rect& a, const cv::Rect& b)
+{
+    const float inter = static_cast<float>((a & b).area());
+    const float uni = static_cast<float>(a.area() + b.area()) - inter;
+    return uni > 0.0f ? inter / uni : 0.0f;
+}
+
+// 依次运行所有帧，记录每帧结果和耗时
+PrecisionStats run_frames(const std::string& model_path, const DetectorConfig& base_config,
+                          InferencePrecision precision, const std::vector<cv::Mat>& frames,
+                          std::vector<std::vector<Blade>>& results)
+{
+    DetectorConfig config = base_config;
+    config.precision = precision;
+    config.async_requests = 1;
+    Detector detector(model_path, config);
+
+    PrecisionStats stats;
+    stats.precision = precision;
+    stats.device = detector.getDevice();
+
+    // 预热一帧，排除首次推理的初始化开销
+    if (!frames.empty()) {
+        detector.Detect(frames.front());
+    }
+
+    results.resize(frames.size());
+    double total_ms = 0.0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        auto start = std::chrono::steady_clock::now();
+        results[i] = detector.Detect(frames[i]);
+        auto end = std::chrono::steady_clock::now();
+
+        const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        total_ms += ms;
+        stats.max_ms = std::max(stats.max_ms, ms);
+        stats.detections += static_cast<int>(results[i].size());
+    }
+    stats.mean_ms = frames.empty() ? 0.0 : total_ms / frames.size();
+    return stats;
+}
+
+} // namespace
+
+const char* precision_name(InferencePrecision precision)
+{
+    switch (precision) {
+    case InferencePrecision::Default: return "Default";
+    case InferencePrecision::FP32: return "FP32";
+    case InferencePrecision::BF16: return "BF16";
+    case InferencePrecision::FP16: return "FP16";
+    case InferencePrecision::INT8: return "INT8";
+    }
+    return "Unknown";
+}
+
+PrecisionReport compare_precisions(const std::string& model_path,
+                                   const DetectorConfig& base_config,
+                                   InferencePrecision reference,
+                                   InferencePrecision candidate,
+                                   const std::vector<cv::Mat>& frames)
+{
+    PrecisionReport report;
+    report.frames = static_cast<int>(frames.size());
+
+    std::vector<std::vector<Blade>> ref_results;
+    std::vector<std::vector<Blade>> cand_results;
+    report.reference = run_frames(model_path, base_config, reference, frames, ref_results);
+    report.candidate = run_frames(model_path, base_config, candidate, frames, cand_results);
+
+    double iou_sum = 0.0;
+    double kpt_sum = 0.0;
+    int kpt_count = 0;
+    report.min_iou = 1.0;
+
+    for (size_t f = 0; f < frames.size(); ++f) {
+        const std::vector<Blade>& refs = ref_results[f];
+        const std::vector<Blade>& cands = cand_results[f];
+        std::vector<bool> used(cands.size(), false);
+
+        // 贪心配对：每个基准目标取同类别中 IoU 最大且未被占用的候选
+        for (const Blade& ref : refs) {
+            int best = -1;
+            float best_iou = kMatchIoU;
+            for (size_t j = 0; j < cands.size(); ++j) {
+                if (used[j] || cands[j].cls != ref.cls) continue;
+                const float iou = rect_iou(ref.rect, cands[j].rect);
+                if (iou >= best_iou) {
+                    best_iou = iou;
+                    best = static_cast<int>(j);
+                }
+            }
+
+            if (best < 0) {
+                ++report.missed;
+                continue;
+            }
+            used[best] = true;
+            ++report.matched;
+            iou_sum += best_iou;
+            report.min_iou = std::min(report.min_iou, static_cast<double>(best_iou));
+
+            // 只比较两边都有效的关键点
+            const Blade& cand = cands[best];
+            for (int k = 0; k < BLADE_KPT_NUM; ++k) {
+                if (ref.kpt[k].x < 0 || cand.kpt[k].x < 0) continue;
+                const double err = std::hypot(ref.kpt[k].x - cand.kpt[k].x,
+                                              ref.kpt[k].y - cand.kpt[k].y);
+                kpt_sum += err;
+                report.max_kpt_error = std::max(report.max_kpt_error, err);
+                ++kpt_count;
+            }
+        }
+
+        report.extra += static_cast<int>(std::count(used.begin(), used.end(), false));
+    }
+
+    if (report.matched > 0) {
+        report.mean_iou = iou_sum / report.matched;
+    } else {
+        report.min_iou = 0.0;
+    }
+    if (kpt_count > 0) {
+        report.mean_kpt_error = kpt_sum / kpt_count;
+    }
+    return report;
+}
+
+std::string format_precision_report(const PrecisionReport& report)
+{
+    char buffer[1024];
+    const double speedup = report.candidate.mean_ms > 0.0
+        ? report.reference.mean_ms / report.candidate.mean_ms : 0.0;
+    std::snprintf(buffer, sizeof(buffer),
+                  "Frames: %d\n"
+                  "%s (%s): %.2f ms/frame (max %.2f), %d detections\n"
+                  "%s (%s): %.2f ms/frame (max %.2f), %d detections\n"
+                  "Speedup: %.2fx\n"
+                  "Matched: %d, missed: %d, extra: %d\n"
+                  "Box IoU: mean %.4f, min %.4f\n"
+                  "Keypoint error: mean %.2f px, max %.2f px",
+                  report.frames,
+                  precision_name(report.reference.precision), report.reference.device.c_str(),
+                  report.reference.mean_ms, report.reference.max_ms, report.reference.detections,
+                  precision_name(report.candidate.precision), report.candidate.device.c_str(),
+                  report.candidate.mean_ms, report.candidate.max_ms, report.candidate.detections,
+                  speedup,
+                  report.matched, report.missed, report.extra,
+                  report.mean_iou, report.min_iou,
+                  report.mean_kpt_error, report.max_kpt_error);
+    return buffer;
+}
+
+} // namespace rm_buff
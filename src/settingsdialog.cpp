@@ -0,0 +1,79 @@
+#include "settingsdialog.h"
+#include "precisioncheck.h"
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QVBoxLayout>
+
+SettingsDialog::SettingsDialog(const rm_buff::DetectorConfig& config, QWidget *parent)
+    : QDialog(parent)
+    , config_(config)
+{
+    setWindowTitle(tr("参数设置"));
+
+    precisionCombo_ = new QComboBox(this);
+    addPrecisionItems(precisionCombo_);
+    precisionCombo_->setCurrentIndex(precisionCombo_->findData(static_cast<int>(config.precision)));
+
+    inputSizeSpin_ = new QSpinBox(this);
+    inputSizeSpin_->setRange(160, 1280);
+    inputSizeSpin_->setSingleStep(32);
+    inputSizeSpin_->setSuffix(tr(" px"));
+    inputSizeSpin_->setValue(config.input_size);
+    inputSizeSpin_->setToolTip(tr("网络输入边长，须为 32 的倍数。320 的计算量约为 640 的 1/4"));
+
+    graphPreprocessCheck_ = new QCheckBox(tr("在推理图中完成 letterbox 和归一化"), this);
+    graphPreprocessCheck_->setChecked(config.graph_preprocess);
+
+    tryGpuCheck_ = new QCheckBox(tr("优先尝试 GPU（无 GPU 时关闭可加快启动）"), this);
+    tryGpuCheck_->setChecked(config.try_gpu);
+
+    QFormLayout *formLayout = new QFormLayout;
+    formLayout->addRow(tr("推理精度:"), precisionCombo_);
+    formLayout->addRow(tr("输入尺寸:"), inputSizeSpin_);
+    formLayout->addRow(tr("预处理:"), graphPreprocessCheck_);
+    formLayout->addRow(tr("设备:"), tryGpuCheck_);
+
+    QLabel *hintLabel = new QLabel(
+        tr("INT8 需要与模型同目录的 *_int8.xml 量化模型。\n"
+           "切换精度前可通过 工具 → 精度对比 确认精度损失。"), this);
+    hintLabel->setWordWrap(true);
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(
+        QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+    connect(buttonBox, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->addLayout(formLayout);
+    mainLayout->addWidget(hintLabel);
+    mainLayout->addWidget(buttonBox);
+}
+
+rm_buff::DetectorConfig SettingsDialog::config() const
+{
+    rm_buff::DetectorConfig config = config_;
+    config.precision = static_cast<rm_buff::InferencePrecision>(
+        precisionCombo_->currentData().toInt());
+    config.input_size = inputSizeSpin_->value() / 32 * 32;
+    config.graph_preprocess = graphPreprocessCheck_->isChecked();
+    config.try_gpu = tryGpuCheck_->isChecked();
+    return config;
+}
+
+void SettingsDialog::addPrecisionItems(QComboBox *comboBox)
+{
+    const rm_buff::InferencePrecision precisions[] = {
+        rm_buff::InferencePrecision::Default,
+        rm_buff::InferencePrecision::FP32,
+        rm_buff::InferencePrecision::BF16,
+        rm_buff::InferencePrecision::FP16,
+        rm_buff::InferencePrecision::INT8,
+    };
+    for (rm_buff::InferencePrecision precision : precisions) {
+        comboBox->addItem(rm_buff::precision_name(precision), static_cast<int>(precision));
+    }
+}
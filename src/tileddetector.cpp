@@ -0,0 +1,252 @@
+#include "tileddetector.h"
+#include <algorithm>
+
+namespace rm_buff
+{
+
+namespace
+{
+
+// 自适应模式比较变化时使用的降采样宽度
+constexpr int kSampleWidth = 160;
+
+// 把分块内的检测结果平移到原图坐标
+void offset_blades(std::vector<Blade>& blades, const cv::Point& offset)
+{
+    const cv::Point2f offset_f(static_cast<float>(offset.x), static_cast<float>(offset.y));
+    for (Blade& blade : blades) {
+        blade.rect.x += offset.x;
+        blade.rect.y += offset.y;
+        for (cv::Point2f& point : blade.kpt) {
+            if (point.x >= 0 && point.y >= 0) {
+                point += offset_f;
+            }
+        }
+    }
+}
+
+// 目标是否贴着分块的内部边（不是原图边界），这类目标可能被截断
+bool touches_inner_edge(const cv::Rect& rect, const cv::Rect& tile, const cv::Size& frame_size)
+{
+    const int border = 2;
+    if (tile.x > 0 && rect.x <= tile.x + border) return true;
+    if (tile.y > 0 && rect.y <= tile.y + border) return true;
+    if (tile.br().x < frame_size.width && rect.br().x >= tile.br().x - border) return true;
+    if (tile.br().y < frame_size.height && rect.br().y >= tile.br().y - border) return true;
+    return false;
+}
+
+} // namespace
+
+TiledDetector::TiledDetector(const TileConfig& config)
+    : config_(config)
+{
+}
+
+void TiledDetector::setConfig(const TileConfig& config)
+{
+    config_ = config;
+    frame_size_ = cv::Size();
+    reset();
+}
+
+void TiledDetector::reset()
+{
+    reference_.release();
+    blades_.clear();
+    frames_since_refresh_ = 0;
+}
+
+std::vector<cv::Rect> TiledDetector::make_tiles(const cv::Size& size, int tile_size, int overlap)
+{
+    std::vector<cv::Rect> tiles;
+    const int stride = std::max(1, tile_size - overlap);
+
+    auto starts = [tile_size, stride](int length) {
+        std::vector<int> result;
+        if (length <= tile_size) {
+            result.push_back(0);
+            return result;
+        }
+        for (int pos = 0; ; pos += stride) {
+            if (pos + tile_size >= length) {
+                result.push_back(length - tile_size);
+                break;
+            }
+            result.push_back(pos);
+        }
+        return result;
+    };
+
+    const int tile_w = std::min(tile_size, size.width);
+    const int tile_h = std::min(tile_size, size.height);
+    for (int y : starts(size.height)) {
+        for (int x : starts(size.width)) {
+            tiles.emplace_back(x, y, tile_w, tile_h);
+        }
+    }
+    return tiles;
+}
+
+const std::vector<Blade>& TiledDetector::Detect(Detector& detector, const cv::Mat& src_img)
+{
+    raw_.clear();
+    if (src_img.empty()) {
+        blades_.clear();
+        return blades_;
+    }
+
+    // 不超过一个分块的图像直接整帧检测
+    if (src_img.cols <= config_.tile_size && src_img.rows <= config_.tile_size) {
+        active_tiles_.clear();
+        blades_ = detector.Detect(src_img);
+        timings_ = detector.getLastTimings();
+        return blades_;
+    }
+
+    if (src_img.size() != frame_size_) {
+        frame_size_ = src_img.size();
+        tiles_ = make_tiles(frame_size_, config_.tile_size, config_.overlap);
+        reference_.release();
+    }
+
+    if (config_.adaptive) {
+        select_tiles(src_img);
+    } else {
+        active_tiles_ = tiles_;
+    }
+
+    // 分块是原图的 ROI 视图，不拷贝像素；缓冲在帧间复用，分块数不变时不申请内存
+    views_.clear();
+    offsets_.clear();
+    for (const cv::Rect& tile : active_tiles_) {
+        views_.push_back(src_img(tile));
+        offsets_.push_back(tile.tl());
+    }
+    if (config_.include_full_frame) {
+        views_.push_back(src_img);
+        offsets_.emplace_back(0, 0);
+    }
+
+    if (detector.getConfig().batch_size != 1) {
+        detector.Detect(views_, results_);
+        timings_ = detector.getLastTimings();
+    } else {
+        // 逐块提交到推理请求池，预处理在本线程进行，推理并行
+        results_.resize(views_.size());
+        detector.DetectPooled(views_.data(), static_cast<int>(views_.size()), results_.data(), &timings_);
+    }
+    // 视图引用着原图，检测完就释放，不妨碍解码阶段复用帧缓冲
+    views_.clear();
+
+    for (size_t i = 0; i < offsets_.size(); ++i) {
+        offset_blades(results_[i], offsets_[i]);
+        const bool is_tile = i < active_tiles_.size();
+        for (Blade& blade : results_[i]) {
+            // 被分块边缘截断的目标交给相邻分块或整帧检测
+            if (is_tile && config_.include_full_frame &&
+                touches_inner_edge(blade.rect, active_tiles_[i], frame_size_)) {
+                continue;
+            }
+            raw_.push_back(blade);
+        }
+    }
+
+    merge(detector);
+    return blades_;
+}
+
+void TiledDetector::select_tiles(const cv::Mat& src_img)
+{
+    const int height = std::max(1, src_img.rows * kSampleWidth / src_img.cols);
+    cv::resize(src_img, small_, cv::Size(kSampleWidth, height), 0, 0, cv::INTER_AREA);
+    if (small_.channels() == 3) {
+        cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
+    } else {
+        small_.copyTo(gray_);
+    }
+
+    // 首帧、尺寸变化或到达刷新间隔时检测全部分块
+    const bool refresh = reference_.size() != gray_.size() ||
+                         ++frames_since_refresh_ >= config_.refresh_interval;
+    if (refresh) {
+        frames_since_refresh_ = 0;
+        active_tiles_ = tiles_;
+        gray_.copyTo(reference_);
+        return;
+    }
+
+    cv::absdiff(gray_, reference_, diff_);
+    gray_.copyTo(reference_);
+
+    // 分块的优先级：上一帧有目标 > 变化量大
+    const double scale = static_cast<double>(kSampleWidth) / src_img.cols;
+    std::vector<std::pair<double, size_t>>& candidates = tile_priority_;
+    candidates.clear();
+    for (size_t i = 0; i < tiles_.size(); ++i) {
+        const cv::Rect& tile = tiles_[i];
+        double priority = -1.0;
+        for (const Blade& blade : blades_) {
+            if ((blade.rect & tile).area() > 0) {
+                priority = 1e9;
+                break;
+            }
+        }
+        if (priority < 0) {
+            cv::Rect small_tile(cvRound(tile.x * scale), cvRound(tile.y * scale),
+                                std::max(1, cvRound(tile.width * scale)),
+                                std::max(1, cvRound(tile.height * scale)));
+            small_tile &= cv::Rect(0, 0, diff_.cols, diff_.rows);
+            if (!small_tile.empty()) {
+                const double change = cv::mean(diff_(small_tile))[0];
+                if (change >= config_.change_threshold) {
+                    priority = change;
+                }
+            }
+        }
+        if (priority >= 0) {
+            candidates.emplace_back(priority, i);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+                  return a.first > b.first;
+              });
+    if (config_.max_tiles > 0 && static_cast<int>(candidates.size()) > config_.max_tiles) {
+        candidates.resize(config_.max_tiles);
+    }
+
+    active_tiles_.clear();
+    for (const auto& candidate : candidates) {
+        active_tiles_.push_back(tiles_[candidate.second]);
+    }
+}
+
+void TiledDetector::merge(const Detector& detector)
+{
+    // 复用 postprocess 的 NMS，框已是原图坐标
+    candidates_.clear();
+    for (const Blade& blade : raw_) {
+        candidates_.cx.push_back(blade.rect.x + blade.rect.width * 0.5f);
+        candidates_.cy.push_back(blade.rect.y + blade.rect.height * 0.5f);
+        candidates_.w.push_back(static_cast<float>(blade.rect.width));
+        candidates_.h.push_back(static_cast<float>(blade.rect.height));
+        candidates_.score.push_back(blade.prob);
+        candidates_.class_id.push_back(static_cast<int>(blade.cls));
+        candidates_.batch.push_back(0);
+    }
+
+    NmsOptions opts;
+    opts.iou_thres = detector.getNMSThreshold();
+    opts.class_agnostic = detector.getConfig().nms_class_agnostic;
+    opts.max_det = detector.getConfig().max_det;
+    non_max_suppression(candidates_, opts, workspace_, keep_);
+
+    blades_.clear();
+    for (int idx : keep_) {
+        blades_.push_back(raw_[idx]);
+    }
+}
+
+} // namespace rm_buff
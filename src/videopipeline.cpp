@@ -0,0 +1,228 @@
+#include "videopipeline.h"
+#include <algorithm>
+#include <chrono>
+
+VideoPipeline::VideoPipeline(int depth)
+    : free_(std::max(2, depth))
+    , decoded_(std::max(2, depth))
+    , processed_(std::max(2, depth))
+{
+    // 帧包数量不超过队列容量，入队永远不会失败
+    for (int i = 0; i < std::max(2, depth); ++i) {
+        packets_.push_back(std::make_unique<FramePacket>());
+        free_.push(packets_.back().get());
+    }
+}
+
+VideoPipeline::~VideoPipeline()
+{
+    stop();
+}
+
+void VideoPipeline::start(DecodeFn decode, StageFn process, StageFn skip,
+                          StageFn present, FinishedFn finished)
+{
+    stop();
+
+    decode_ = std::move(decode);
+    process_ = std::move(process);
+    skip_ = std::move(skip);
+    present_ = std::move(present);
+    finished_ = std::move(finished);
+
+    processFps_ = 0.0;
+    lagMs_ = 0.0;
+    dropped_ = 0;
+    skipped_ = 0;
+    stopping_ = false;
+    running_ = true;
+    decodeThread_ = std::thread(&VideoPipeline::decodeLoop, this);
+    processThread_ = std::thread(&VideoPipeline::processLoop, this);
+    presentThread_ = std::thread(&VideoPipeline::presentLoop, this);
+}
+
+void VideoPipeline::stop()
+{
+    if (!running_) {
+        return;
+    }
+
+    stopping_ = true;
+    decodeThread_.join();
+    processThread_.join();
+    presentThread_.join();
+    running_ = false;
+
+    // 丢弃在途的帧，所有帧包归还给空闲队列（保留帧缓冲供下次复用）
+    free_.clear();
+    decoded_.clear();
+    processed_.clear();
+    for (auto& packet : packets_) {
+        packet->processed.release();
+        packet->result.reset();
+        packet->endOfStream = false;
+        packet->dropped = false;
+        free_.push(packet.get());
+    }
+}
+
+void VideoPipeline::setPlaybackRate(double rate)
+{
+    rate_ = rate;
+    ++rateVersion_;
+}
+
+VideoPipeline::Stats VideoPipeline::stats() const
+{
+    Stats stats;
+    stats.processFps = processFps_;
+    stats.lagMs = lagMs_;
+    stats.dropped = dropped_;
+    stats.skipped = skipped_;
+    return stats;
+}
+
+void VideoPipeline::idle()
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+}
+
+void VideoPipeline::decodeLoop()
+{
+    while (!stopping_) {
+        FramePacket* packet = nullptr;
+        if (!free_.pop(packet)) {
+            idle();
+            continue;
+        }
+
+        bool ok = false;
+        try {
+            ok = decode_(*packet);
+        } catch (const std::exception&) {
+            ok = false;
+        }
+        packet->endOfStream = !ok;
+        packet->dropped = false;
+        packet->skippedFrames = -1;
+        decoded_.push(packet);
+        if (!ok) {
+            break;
+        }
+    }
+}
+
+void VideoPipeline::processLoop()
+{
+    using Clock = std::chrono::steady_clock;
+
+    // 计时基准：某一帧的时间戳对应的单调时钟时刻
+    bool anchored = false;
+    Clock::time_point anchorTime;
+    double anchorPts = 0.0;
+    int seenRateVersion = rateVersion_;
+
+    // 帧率统计窗口
+    Clock::time_point windowStart = Clock::now();
+    int windowFrames = 0;
+
+    while (!stopping_) {
+        FramePacket* packet = nullptr;
+        if (!decoded_.pop(packet)) {
+            idle();
+            continue;
+        }
+
+        if (packet->endOfStream) {
+            processed_.push(packet);
+            break;
+        }
+
+        // 计算显示时刻；时间戳倒退（如解码器跳帧）或倍速变化时以当前帧重新计时
+        const Clock::time_point now = Clock::now();
+        const double rate = rate_;
+        const int rateVersion = rateVersion_;
+        if (!anchored || rateVersion != seenRateVersion || packet->timestampMs < anchorPts) {
+            anchored = true;
+            anchorTime = now;
+            anchorPts = packet->timestampMs;
+            seenRateVersion = rateVersion;
+        }
+        if (rate > 0) {
+            packet->due = anchorTime + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::milli>((packet->timestampMs - anchorPts) / rate));
+        } else {
+            packet->due = now;
+        }
+
+        const double lateMs = std::chrono::duration<double, std::milli>(now - packet->due).count();
+        const bool late = rate > 0 && lateMs > lateToleranceMs_;
+        const LatePolicy policy = latePolicy_;
+
+        // 丢弃迟到帧：只在已有更新的帧等待时丢弃，解码本身跟不上时仍然显示
+        packet->dropped = late && policy == LatePolicy::Drop && !decoded_.empty();
+        if (packet->dropped) {
+            ++dropped_;
+            processed_.push(packet);   // 由显示线程归还，保持每个队列单生产者
+            continue;
+        }
+
+        if (late && policy == LatePolicy::SkipInference && skip_) {
+            ++skipped_;
+            skip_(*packet);
+        } else {
+            process_(*packet);
+            ++windowFrames;
+        }
+        processed_.push(packet);
+
+        // 每秒更新一次实际推理帧率
+        const Clock::time_point end = Clock::now();
+        const double elapsed = std::chrono::duration<double>(end - windowStart).count();
+        if (elapsed >= 1.0) {
+            processFps_ = windowFrames / elapsed;
+            windowFrames = 0;
+            windowStart = end;
+        }
+    }
+}
+
+void VideoPipeline::presentLoop()
+{
+    using Clock = std::chrono::steady_clock;
+
+    while (!stopping_) {
+        FramePacket* packet = nullptr;
+        if (!processed_.pop(packet)) {
+            idle();
+            continue;
+        }
+
+        if (packet->endOfStream) {
+            finished_();
+            break;
+        }
+        if (packet->dropped) {
+            free_.push(packet);
+            continue;
+        }
+
+        // 等到计划的显示时刻，分段睡眠以便及时响应停止；已迟到的帧立即显示
+        Clock::time_point now = Clock::now();
+        while (!stopping_ && now < packet->due) {
+            std::this_thread::sleep_for(std::min<Clock::duration>(packet->due - now, std::chrono::milliseconds(5)));
+            now = Clock::now();
+        }
+        if (stopping_) {
+            break;
+        }
+        packet->lagMs = std::max(0.0, std::chrono::duration<double, std::milli>(now - packet->due).count());
+        lagMs_ = packet->lagMs;
+
+        present_(*packet);
+
+        packet->processed.release();
+        packet->result.reset();
+        free_.push(packet);
+    }
+}